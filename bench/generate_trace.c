@@ -0,0 +1,145 @@
+// deterministic generator for synthetic simulation traces, used by make bench
+// the output is a comma-separated table: a monotone time column followed by the signal columns
+//
+// usage: generate_trace [--rows N] [--columns N] [--noise SIGMA] [--plateaus FRACTION] [--seed N]
+//
+// time steps vary like the adaptive steps of a circuit simulator, every signal is a mix of sines
+// plus gaussian noise, and plateaus hold a signal at a constant value for a run of rows
+// (settled nodes, digital levels), which is what the redundancy filter and the compressor see
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+static uint64_t _state;
+
+static uint64_t _random(void)
+{
+    _state ^= _state << 13;
+    _state ^= _state >> 7;
+    _state ^= _state << 17;
+    return _state;
+}
+
+// uniform in [0, 1)
+static double _uniform(void)
+{
+    return (double)(_random() >> 11) / (double)(1ull << 53);
+}
+
+static double _gaussian(void)
+{
+    double u = _uniform();
+    double v = _uniform();
+    return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static const char* _get_option(int argc, char** argv, const char* name, const char* default_value)
+{
+    for(int i = 1; i < argc - 1; ++i)
+    {
+        if(strcmp(argv[i], name) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return default_value;
+}
+
+struct signal {
+    double frequency[3];
+    double amplitude[3];
+    double offset;
+    size_t plateau; // remaining rows of the current plateau
+    double level;
+};
+
+int main(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0))
+        {
+            puts("usage: generate_trace [--rows N] [--columns N] [--noise SIGMA] [--plateaus FRACTION] [--seed N]");
+            return 0;
+        }
+    }
+    size_t rows = strtoull(_get_option(argc, argv, "--rows", "1000000"), NULL, 10);
+    size_t columns = strtoull(_get_option(argc, argv, "--columns", "4"), NULL, 10);
+    double noise = atof(_get_option(argc, argv, "--noise", "1e-3"));
+    double plateaus = atof(_get_option(argc, argv, "--plateaus", "0.3"));
+    _state = strtoull(_get_option(argc, argv, "--seed", "1"), NULL, 10) * 0x9E3779B97F4A7C15ull + 1;
+    if(columns < 1)
+    {
+        fputs("generate_trace: at least one column is needed\n", stderr);
+        return 1;
+    }
+    if((plateaus < 0.0) || (plateaus >= 1.0))
+    {
+        fputs("generate_trace: --plateaus must be in [0, 1)\n", stderr);
+        return 1;
+    }
+
+    struct signal* signals = malloc(sizeof(*signals) * columns);
+    for(size_t c = 0; c < columns; ++c)
+    {
+        for(size_t k = 0; k < 3; ++k)
+        {
+            signals[c].frequency[k] = 1e6 * pow(10.0, 3.0 * _uniform());
+            signals[c].amplitude[k] = 1.0 / (k + 1);
+        }
+        signals[c].offset = 2.0 * _uniform() - 1.0;
+        signals[c].plateau = 0;
+        signals[c].level = 0.0;
+    }
+
+    // plateaus start with this probability per row, their mean length is 200 rows
+    double meanlength = 200.0;
+    double start = plateaus / (meanlength * (1.0 - plateaus));
+    double time = 0.0;
+    double step = 1e-9;
+    for(size_t row = 0; row < rows; ++row)
+    {
+        printf("%.15e", time);
+        for(size_t c = 0; c < columns; ++c)
+        {
+            struct signal* signal = signals + c;
+            double value;
+            if(signal->plateau > 0)
+            {
+                value = signal->level;
+                --signal->plateau;
+            }
+            else
+            {
+                value = signal->offset;
+                for(size_t k = 0; k < 3; ++k)
+                {
+                    value += signal->amplitude[k] * sin(2.0 * M_PI * signal->frequency[k] * time);
+                }
+                value += noise * _gaussian();
+                if(_uniform() < start)
+                {
+                    signal->level = value;
+                    signal->plateau = (size_t)(-meanlength * log(1.0 - _uniform()));
+                }
+            }
+            printf(",%.15e", value);
+        }
+        putchar('\n');
+        // adaptive time step: shrinks around activity and grows back, never goes backwards
+        step *= exp2(_uniform() - 0.5);
+        if(step < 1e-12)
+        {
+            step = 1e-12;
+        }
+        else if(step > 1e-8)
+        {
+            step = 1e-8;
+        }
+        time += step;
+    }
+    free(signals);
+    return 0;
+}
@@ -0,0 +1,82 @@
+// micro-benchmark: _str_to_number against the previous copy + atof implementation
+#define FD_LIBRARY
+#include "../filter_data.c"
+
+#include <time.h>
+
+#define NUMFIELDS 1000000
+#define REPETITIONS 10
+
+static double _atof_str_to_number(const char* str, const char* endptr)
+{
+    char* tmp = malloc(endptr - str + 1);
+    const char* ptr = str;
+    char* tptr = tmp;
+    while(ptr != endptr)
+    {
+        *tptr = *ptr;
+        ++ptr;
+        ++tptr;
+    }
+    *tptr = 0;
+    double num = atof(tmp);
+    free(tmp);
+    return num;
+}
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double _run(double (*func)(const char*, const char*), const char* buf, const size_t* offsets, double* checksum)
+{
+    double start = _now();
+    double sum = 0.0;
+    for(int r = 0; r < REPETITIONS; ++r)
+    {
+        for(size_t i = 0; i < NUMFIELDS; ++i)
+        {
+            sum += func(buf + offsets[i], buf + offsets[i + 1] - 1);
+        }
+    }
+    *checksum = sum;
+    return _now() - start;
+}
+
+int main(void)
+{
+    _init_number_parser();
+    // SPICE-style fields: %.15e with exponents spread over typical simulation ranges
+    char* buf = malloc(NUMFIELDS * 32);
+    size_t* offsets = malloc((NUMFIELDS + 1) * sizeof(*offsets));
+    size_t pos = 0;
+    unsigned int seed = 1;
+    for(size_t i = 0; i < NUMFIELDS; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        double mantissa = (seed >> 8) / (double)(1 << 24) * 10.0;
+        int exponent = (int)((seed >> 4) % 24) - 15;
+        offsets[i] = pos;
+        pos += sprintf(buf + pos, "%.15e", (seed & 1 ? -1 : 1) * mantissa * pow(10, exponent)) + 1;
+    }
+    offsets[NUMFIELDS] = pos;
+
+    double reference, checksum;
+    double tatof = _run(_atof_str_to_number, buf, offsets, &reference);
+    double tfast = _run(_str_to_number, buf, offsets, &checksum);
+    double fields = (double)NUMFIELDS * REPETITIONS;
+    printf("copy + atof:     %7.1f ns/field  %7.1f MB/s\n", tatof / fields * 1e9, pos * REPETITIONS / tatof / 1e6);
+    printf("_str_to_number:  %7.1f ns/field  %7.1f MB/s\n", tfast / fields * 1e9, pos * REPETITIONS / tfast / 1e6);
+    printf("speedup:         %7.2fx\n", tatof / tfast);
+    if(checksum != reference)
+    {
+        fputs("number_parser: checksum mismatch\n", stderr);
+        return 1;
+    }
+    free(buf);
+    free(offsets);
+    return 0;
+}
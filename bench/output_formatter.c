@@ -0,0 +1,104 @@
+// micro-benchmark: buffered _format_fixed output against printf, including a differential
+// check that both produce identical bytes for random doubles
+#define FD_LIBRARY
+#include "../filter_data.c"
+
+#include <time.h>
+
+#define NUMCHECKS 10000000
+#define NUMPOINTS 2000000
+
+static uint64_t _state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t _random(void)
+{
+    _state ^= _state << 13;
+    _state ^= _state >> 7;
+    _state ^= _state << 17;
+    return _state;
+}
+
+static double _random_double(void)
+{
+    switch(_random() % 4)
+    {
+        case 0: // any bit pattern
+        {
+            uint64_t bits = _random();
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            return d;
+        }
+        case 1: // exact binary fractions, exercises rounding ties
+            return (double)(int64_t)(_random() % 2000001 - 1000000) / (double)(1ull << (_random() % 24));
+        case 2: // typical simulation values
+            return ((double)(_random() >> 11) / (double)(1ull << 53) - 0.5) * pow(10, (int)(_random() % 30) - 20);
+        default: // short decimals
+            return (double)(int64_t)(_random() % 200001 - 100000) / (double)_powers_of_ten[_random() % 8];
+    }
+}
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    char expected[512];
+    char actual[FORMAT_BUFFER_SIZE];
+    long mismatches = 0;
+    for(long i = 0; i < NUMCHECKS; ++i)
+    {
+        double value = _random_double();
+        int decimals = _random() % 24;
+        int explength = snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+        if(explength >= FORMAT_BUFFER_SIZE)
+        {
+            continue;
+        }
+        size_t length = _format_fixed(actual, value, decimals);
+        if((length != (size_t)explength) || (memcmp(actual, expected, length) != 0))
+        {
+            if(mismatches < 10)
+            {
+                fprintf(stderr, "output_formatter: mismatch for %a (%d decimals): '%s' vs '%.*s'\n", value, decimals, expected, (int)length, actual);
+            }
+            ++mismatches;
+        }
+    }
+    printf("differential check:  %d random doubles, %ld mismatches\n", NUMCHECKS, mismatches);
+
+    double* values = malloc(2 * NUMPOINTS * sizeof(*values));
+    for(size_t i = 0; i < 2 * NUMPOINTS; ++i)
+    {
+        values[i] = ((double)(_random() >> 11) / (double)(1ull << 53)) * pow(10, (int)(_random() % 12) - 9);
+    }
+    FILE* devnull = fopen("/dev/null", "w");
+    double start = _now();
+    for(size_t i = 0; i < NUMPOINTS; ++i)
+    {
+        fprintf(devnull, "%.*f%s%.*f\n", 16, values[2 * i], " ", 16, values[2 * i + 1]);
+    }
+    fflush(devnull);
+    double tprintf = _now() - start;
+    struct output* output = create_output(fileno(devnull));
+    start = _now();
+    for(size_t i = 0; i < NUMPOINTS; ++i)
+    {
+        _output_fixed(output, values[2 * i], 16);
+        _output_string(output, " ", 1);
+        _output_fixed(output, values[2 * i + 1], 16);
+        _output_string(output, "\n", 1);
+    }
+    destroy_output(output);
+    double tbuffered = _now() - start;
+    fclose(devnull);
+    free(values);
+    printf("printf:              %7.1f ns/point\n", tprintf / NUMPOINTS * 1e9);
+    printf("buffered formatter:  %7.1f ns/point\n", tbuffered / NUMPOINTS * 1e9);
+    printf("speedup:             %7.2fx\n", tprintf / tbuffered);
+    return mismatches ? 1 : 0;
+}
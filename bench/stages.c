@@ -0,0 +1,466 @@
+// per-stage benchmark: times every stage of main (parsing, filtering, post-processing, printing)
+// on its own and compares the throughput with a stored baseline
+//
+// usage: stages <trace> [--columns 1-4] [-j N] [--repetitions N]
+//               [--baseline FILE] [--save-baseline FILE] [--max-slowdown PERCENT]
+//
+// every stage starts from freshly parsed data, only the stage itself is timed and the best of all
+// repetitions is reported. Throughput is given in input MB/s and in points/s (rows * series).
+// With --baseline the exit status is 1 if a stage got slower than --max-slowdown percent
+#define FD_LIBRARY
+#include "../filter_data.c"
+
+#include <time.h>
+
+#define MAX_STAGES 16
+#define STAGE_NAME_SIZE 32
+#if defined(__GNUC__) && !defined(__clang__)
+#define COMPILER "gcc " __VERSION__
+#else
+#define COMPILER __VERSION__
+#endif
+
+struct bench {
+    const char* filename;
+    size_t filesize;
+    size_t rows;
+    unsigned int xindex;
+    unsigned int* yindices;
+    size_t numseries;
+    struct filterplan* noplan;
+    struct filterplan* plan;
+    unsigned int numthreads;
+};
+
+struct stage {
+    const char* name;
+    double (*run)(const struct bench*);
+    double seconds;
+};
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static struct data* _parse(const struct bench* bench, const struct filterplan* plan, unsigned int numthreads)
+{
+    struct data* data = read_data(bench->filename, 0, bench->xindex, bench->yindices, bench->numseries, ",", plan, REAL, 0, -1, numthreads, 0, COMPLEX_MAGNITUDE, NULL);
+    if(!data)
+    {
+        exit(1);
+    }
+    return data;
+}
+
+static double _run_parse(const struct bench* bench)
+{
+    double start = _now();
+    struct data* data = _parse(bench, bench->noplan, 1);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_parse_threaded(const struct bench* bench)
+{
+    double start = _now();
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+// feeds the parsed rows through the filter plan block by block, like the parser does
+static double _run_filter(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    struct data* filtered = _create_data(data->length, data->numseries, REAL, -1);
+    struct datablock* block = malloc(sizeof(*block));
+    struct seriesblock* seriesblock = _create_seriesblock(data->numseries);
+    double start = _now();
+    for(size_t first = 0; first < data->length; first += BLOCK_SIZE)
+    {
+        size_t length = data->length - first < BLOCK_SIZE ? data->length - first : BLOCK_SIZE;
+        block->length = length;
+        block->firstrow = first;
+        memcpy(block->x, data->x + first, sizeof(*block->x) * length);
+        memset(block->keep, 1, length);
+        if(seriesblock)
+        {
+            for(size_t s = 0; s < data->numseries; ++s)
+            {
+                memcpy(seriesblock->y + s * BLOCK_SIZE, data->series[s].y.d + first, sizeof(double) * length);
+            }
+        }
+        else
+        {
+            memcpy(block->y, data->series[0].y.d + first, sizeof(*block->y) * length);
+        }
+        _filter_rows(block, seriesblock, bench->plan, NULL, filtered);
+    }
+    double seconds = _now() - start;
+    _destroy_seriesblock(seriesblock);
+    free(block);
+    _destroy_data(filtered);
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_sample(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    // keeps about a quarter of the rows
+    double interval = 4.0 * (data->x[data->length - 1] - data->x[0]) / data->length;
+    double start = _now();
+    _sample_data(data, data->x[0], interval);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_digital(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    double start = _now();
+    _digitize_data(data, 0.0, 0.1, 0, 0, 0, 1);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_redundant(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    double start = _now();
+    _remove_redundant_points(data, 16, 16);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_compress(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    double start = _now();
+    _compress_data(data, 1e-3, 1);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_reduce(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    double start = _now();
+    _reduce_data(data, data->length / 100 + 4, REDUCE_LTTB);
+    double seconds = _now() - start;
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_print_text(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    int fd = open("/dev/null", O_WRONLY);
+    double start = _now();
+    struct output* output = create_output(fd);
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        _print_row(output, data, i, 16, 16, " ");
+    }
+    destroy_output(output);
+    double seconds = _now() - start;
+    close(fd);
+    _destroy_data(data);
+    return seconds;
+}
+
+static double _run_print_binary(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    int fd = open("/dev/null", O_WRONLY);
+    double start = _now();
+    struct output* output = create_output(fd);
+    write_binary(output, data);
+    destroy_output(output);
+    double seconds = _now() - start;
+    close(fd);
+    _destroy_data(data);
+    return seconds;
+}
+
+static void _count_points(const double* x, const double* y, size_t n, void* userdata)
+{
+    (void)x;
+    (void)y;
+    *((size_t*)userdata) += n;
+}
+
+// the library interface: the same filters as the filter stage plus -r, pushed in chunks
+static double _run_push(const struct bench* bench)
+{
+    struct data* data = _parse(bench, bench->noplan, bench->numthreads);
+    size_t numseries = data->numseries;
+    double* y = malloc(sizeof(*y) * data->length * numseries);
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            y[i * numseries + s] = data->series[s].y.d[i];
+        }
+    }
+    size_t kept = 0;
+    double start = _now();
+    struct fd_context* ctx = fd_create(numseries, _count_points, &kept);
+    fd_add_filter(ctx, FD_XSCALE, 1e9);
+    fd_add_filter(ctx, FD_YSHIFT, -0.5);
+    fd_add_filter(ctx, FD_XMIN, 1e3);
+    fd_add_filter(ctx, FD_EVERY_NTH, 2);
+    fd_set_remove_redundant(ctx, 16, 16);
+    for(size_t first = 0; first < data->length; first += 65536)
+    {
+        size_t n = data->length - first < 65536 ? data->length - first : 65536;
+        fd_push(ctx, data->x + first, y + first * numseries, n);
+    }
+    fd_finish(ctx);
+    fd_destroy(ctx);
+    double seconds = _now() - start;
+    free(y);
+    _destroy_data(data);
+    return seconds;
+}
+
+static const char* _get_option(int argc, char** argv, const char* name, const char* default_value)
+{
+    for(int i = 2; i < argc - 1; ++i)
+    {
+        if(strcmp(argv[i], name) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return default_value;
+}
+
+static void _append_1_arg(struct filterlist* filterlist, filter_func_1_arg func, double value)
+{
+    double* arg = malloc(sizeof(*arg));
+    *arg = value;
+    _append_filter(filterlist, _create_filter_1_arg(func, arg));
+}
+
+// the cpu model and the compiler the numbers were measured with, points/s only compare
+// between runs on the same machine with the same build
+static void _describe_machine(const struct bench* bench, char* machine, size_t size)
+{
+    char model[128] = "unknown cpu";
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    if(cpuinfo)
+    {
+        char line[256];
+        while(fgets(line, sizeof(line), cpuinfo))
+        {
+            const char* colon = strchr(line, ':');
+            if((strncmp(line, "model name", 10) == 0) && colon)
+            {
+                snprintf(model, sizeof(model), "%s", colon + 2);
+                model[strcspn(model, "\n")] = '\0';
+                break;
+            }
+        }
+        fclose(cpuinfo);
+    }
+    long numcpus = sysconf(_SC_NPROCESSORS_ONLN);
+    snprintf(machine, size, "%s, %ld cpus, %u threads, %s", model, numcpus, bench->numthreads, COMPILER);
+}
+
+// the baseline file stores the machine, the trace size and the points/s of every stage:
+//   machine <cpu model, cpus, threads, compiler>
+//   trace <bytes> <rows> <series>
+//   <stage> <points/s>
+static size_t _read_baseline(const char* filename, const struct bench* bench, char names[][STAGE_NAME_SIZE], double* rates)
+{
+    FILE* file = fopen(filename, "r");
+    if(!file)
+    {
+        fprintf(stderr, "stages: could not open baseline '%s'\n", filename);
+        return 0;
+    }
+    char line[256];
+    size_t numstages = 0;
+    while(fgets(line, sizeof(line), file) && (numstages < MAX_STAGES))
+    {
+        if(line[0] == '#')
+        {
+            continue;
+        }
+        size_t bytes, rows, numseries;
+        if(strncmp(line, "machine ", 8) == 0)
+        {
+            char machine[256];
+            _describe_machine(bench, machine, sizeof(machine));
+            line[strcspn(line, "\n")] = '\0';
+            if(strcmp(line + 8, machine) != 0)
+            {
+                fprintf(stderr, "stages: warning: the baseline was recorded on '%s', the changes are not comparable\n", line + 8);
+            }
+        }
+        else if(sscanf(line, "trace %zu %zu %zu", &bytes, &rows, &numseries) == 3)
+        {
+            if((bytes != bench->filesize) || (rows != bench->rows) || (numseries != bench->numseries))
+            {
+                fputs("stages: warning: the baseline was recorded with a different trace\n", stderr);
+            }
+        }
+        else if(sscanf(line, "%31s %lf", names[numstages], rates + numstages) == 2)
+        {
+            ++numstages;
+        }
+    }
+    fclose(file);
+    return numstages;
+}
+
+static int _save_baseline(const char* filename, const struct bench* bench, const struct stage* stages, size_t numstages)
+{
+    FILE* file = fopen(filename, "w");
+    if(!file)
+    {
+        fprintf(stderr, "stages: could not open baseline '%s'\n", filename);
+        return 0;
+    }
+    char machine[256];
+    _describe_machine(bench, machine, sizeof(machine));
+    fputs("# points/s per stage, written by bench/stages --save-baseline\n", file);
+    fprintf(file, "machine %s\n", machine);
+    fprintf(file, "trace %zu %zu %zu\n", bench->filesize, bench->rows, bench->numseries);
+    for(size_t i = 0; i < numstages; ++i)
+    {
+        fprintf(file, "%s %.6e\n", stages[i].name, bench->rows * bench->numseries / stages[i].seconds);
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fputs("usage: stages <trace> [--columns 1-4] [-j N] [--repetitions N] [--baseline FILE] [--save-baseline FILE] [--max-slowdown PERCENT]\n", stderr);
+        return 1;
+    }
+    _init_number_parser();
+    _init_field_scanner();
+    struct bench bench;
+    bench.filename = argv[1];
+    bench.xindex = 0;
+    bench.yindices = _parse_columns(_get_option(argc, argv, "--columns", "1-4"), &bench.numseries);
+    if(!bench.yindices)
+    {
+        return 1;
+    }
+    long numcpus = sysconf(_SC_NPROCESSORS_ONLN);
+    bench.numthreads = atoi(_get_option(argc, argv, "-j", "0"));
+    if(bench.numthreads < 1)
+    {
+        bench.numthreads = numcpus > 0 ? numcpus : 1;
+    }
+    int repetitions = atoi(_get_option(argc, argv, "--repetitions", "3"));
+    double maxslowdown = atof(_get_option(argc, argv, "--max-slowdown", "25"));
+    const char* baseline = _get_option(argc, argv, "--baseline", NULL);
+    const char* save = _get_option(argc, argv, "--save-baseline", NULL);
+
+    struct stat st;
+    if(stat(bench.filename, &st) != 0)
+    {
+        fprintf(stderr, "stages: could not open trace '%s'\n", bench.filename);
+        return 1;
+    }
+    bench.filesize = st.st_size;
+
+    struct filterlist* nofilters = create_filterlist();
+    bench.noplan = plan_filters(nofilters, 1);
+    // a typical invocation: time in ns, offset removed, a window and every other point
+    struct filterlist* filters = create_filterlist();
+    _append_1_arg(filters, _scale_x, 1e9);
+    _append_1_arg(filters, _shift_y, -0.5);
+    _append_1_arg(filters, _x_min, 1e3);
+    int* nth = malloc(sizeof(*nth));
+    *nth = 2;
+    _append_filter(filters, _create_filter_1_arg(_every_nth, nth));
+    bench.plan = plan_filters(filters, 1);
+
+    struct data* data = _parse(&bench, bench.noplan, bench.numthreads);
+    bench.rows = data->length;
+    _destroy_data(data);
+    if(bench.rows < 2)
+    {
+        fputs("stages: the trace needs at least two rows\n", stderr);
+        return 1;
+    }
+
+    struct stage stages[] = {
+        { "parse",          _run_parse,          0.0 },
+        { "parse-threaded", _run_parse_threaded, 0.0 },
+        { "filter",         _run_filter,         0.0 },
+        { "sample",         _run_sample,         0.0 },
+        { "digital",        _run_digital,        0.0 },
+        { "redundant",      _run_redundant,      0.0 },
+        { "compress",       _run_compress,       0.0 },
+        { "reduce",         _run_reduce,         0.0 },
+        { "print-text",     _run_print_text,     0.0 },
+        { "print-binary",   _run_print_binary,   0.0 },
+        { "push",           _run_push,           0.0 },
+    };
+    size_t numstages = sizeof(stages) / sizeof(stages[0]);
+    for(size_t i = 0; i < numstages; ++i)
+    {
+        for(int r = 0; r < repetitions || r == 0; ++r)
+        {
+            double seconds = stages[i].run(&bench);
+            if((r == 0) || (seconds < stages[i].seconds))
+            {
+                stages[i].seconds = seconds;
+            }
+        }
+    }
+
+    char names[MAX_STAGES][STAGE_NAME_SIZE];
+    double rates[MAX_STAGES];
+    size_t numbaseline = baseline ? _read_baseline(baseline, &bench, names, rates) : 0;
+    double points = (double)bench.rows * bench.numseries;
+    int slower = 0;
+    printf("trace: %s, %.1f MB, %zu rows, %zu series, %u threads\n", bench.filename, bench.filesize / 1e6, bench.rows, bench.numseries, bench.numthreads);
+    printf("%-16s %10s %10s %12s %12s %8s\n", "stage", "time/ms", "MB/s", "Mpoints/s", "baseline", "change");
+    for(size_t i = 0; i < numstages; ++i)
+    {
+        double rate = points / stages[i].seconds;
+        printf("%-16s %10.2f %10.1f %12.2f", stages[i].name, stages[i].seconds * 1e3, bench.filesize / stages[i].seconds / 1e6, rate / 1e6);
+        size_t b = 0;
+        while((b < numbaseline) && (strcmp(names[b], stages[i].name) != 0))
+        {
+            ++b;
+        }
+        if(b < numbaseline)
+        {
+            double change = (rate / rates[b] - 1.0) * 100.0;
+            printf(" %12.2f %+7.1f%%", rates[b] / 1e6, change);
+            if(change < -maxslowdown)
+            {
+                fputs("  slower", stdout);
+                slower = 1;
+            }
+        }
+        putchar('\n');
+    }
+
+    int ok = !save || _save_baseline(save, &bench, stages, numstages);
+    destroy_filterplan(bench.noplan);
+    destroy_filterplan(bench.plan);
+    destroy_filterlist(nofilters);
+    destroy_filterlist(filters);
+    free(bench.yindices);
+    return (ok && !slower) ? 0 : 1;
+}
@@ -1,9 +1,70 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <limits.h>
 #include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
 
-#define BUFSIZE 1024
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "filterdata.h"
+
+#define READ_CHUNK_SIZE (1 << 16)
+#define MIN_CHUNK_SIZE (1 << 20)
+#define STREAM_BUFFER_SIZE (1 << 20)
+#define BLOCK_SIZE 1024
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define PRINT_SLICE_ROWS (1 << 16)
+#ifndef IOV_MAX
+#define IOV_MAX 16 // the least posix guarantees
+#endif
+#define FORMAT_BUFFER_SIZE 64
+#define MAX_FAST_DECIMALS 19
+#define VCD_ID_SIZE 8
+#define ARENA_CHUNK_SIZE (1 << 16)
+#define DECOMPRESS_BUFFER_SIZE (1 << 20)
+#define DECOMPRESS_RING_SIZE 4
+#define INDEX_SUFFIX ".fdidx"
+#define INDEX_SEPARATOR_SIZE 16
+#define DEFAULT_INDEX_STRIDE 4096
+#define FILTER_LABEL_SIZE 64
+#define MAX_STATS_STAGES 16
+#define FOLLOW_POLL_MS 250
+#define CHECKPOINT_TMP_SUFFIX ".tmp"
+
+enum ytype {
+    REAL,
+    INTEGER,
+    STRING
+};
+
+// --sample-mode: first keeps the first input point of every interval, the others interpolate
+enum sample_mode {
+    SAMPLE_FIRST,
+    SAMPLE_LINEAR,
+    SAMPLE_CUBIC
+};
 
 struct yvalue {
     union {
@@ -11,28 +72,54 @@ struct yvalue {
         int i;
         const char* str;
     };
-    enum {
-        REAL,
-        INTEGER,
-        STRING
-    } type;
+    enum ytype type;
 };
 
 struct xydatum {
     double x;
     struct yvalue y;
-    int deleted;
 };
 
+// one y column
+struct series {
+    union {
+        double* d;
+        float* f;
+        int* i;
+        const char** str;
+    } y;
+    enum ytype ytype;
+    int yfloat; // real y values are stored in single precision
+    double yfloatscale; // 10^ydecimals
+    uint64_t* deleted;
+};
+
+// column store, x and every y series are kept in separate arrays and deleted points in a bitmap
+// per series. All series share the x column, so a row only disappears once it is deleted in all of them
 struct data {
-    struct xydatum* data;
+    double* x;
+    struct series* series;
+    size_t numseries;
+
     size_t length;
     size_t capacity;
+    struct input* input; // set if x and y point directly into this (mapped) input
+    struct symboltable* symbols; // owns the strings of string series
+};
+
+// parsed rows are filtered in blocks, filters process all rows of a block in one loop
+// and clear the keep flag of rows that should be dropped
+struct datablock {
+    double x[BLOCK_SIZE];
+    double y[BLOCK_SIZE];
+    unsigned char keep[BLOCK_SIZE];
+    size_t length;
+    size_t firstrow; // row index of the first row in the block
 };
 
-typedef int (*filter_func_0_arg)(struct xydatum*, size_t index);
-typedef int (*filter_func_1_arg)(struct xydatum*, size_t index, void*);
-typedef int (*filter_func_2_arg)(struct xydatum*, size_t index, void*, void*);
+typedef void (*filter_func_0_arg)(struct datablock*);
+typedef void (*filter_func_1_arg)(struct datablock*, void*);
+typedef void (*filter_func_2_arg)(struct datablock*, void*, void*);
 
 struct filter {
     union {
@@ -54,6 +141,114 @@ struct filterlist {
     size_t size;
 };
 
+// consecutive scale, shift and range filters are folded into fused stages, which
+// run as one pass over a block using a kernel specialised for the shape of the stage
+enum {
+    SHAPE_PRE_RANGE = 1,  // range check on x before the x transformation
+    SHAPE_X_AFFINE = 2,
+    SHAPE_Y_AFFINE = 4,
+    SHAPE_POST_RANGE = 8, // range check on the transformed x
+    NUM_SHAPES = 16
+};
+
+struct fused_stage {
+    double prexmin;
+    double prexmax;
+    double xscale;
+    double xshift;
+    double yscale;
+    double yshift;
+    double postxmin;
+    double postxmax;
+    unsigned int shape;
+};
+
+struct filterstage {
+    enum {
+        STAGE_FILTER,
+        STAGE_FUSED
+    } type;
+    struct filter* filter;
+    struct fused_stage fused;
+    int yonly; // the filter only transforms y values
+    char label[FILTER_LABEL_SIZE]; // options that make up the stage, for --stats
+};
+
+struct filterplan {
+    struct filterstage* stages;
+    size_t size;
+};
+
+static int _raw_x_range(const struct filterplan* plan, double* xmin, double* xmax);
+
+// --stats: wall and cpu time of every stage and the number of points it removed, plus input
+// and output counters. Everything is only collected if requested, the counters are cheap
+// enough to leave on (one pass over the keep flags of a block per filter stage)
+struct stats_stage {
+    const char* name;
+    double wall; // negative if the stage is not timed on its own
+    double cpu;
+    size_t removed; // points (rows times series) removed by the stage
+};
+
+struct stats {
+    struct stats_stage stages[MAX_STATS_STAGES];
+    size_t numstages;
+    double wallbegin; // start of the run
+    double cpubegin;
+    double wallstart; // start of the current stage
+    double cpustart;
+    size_t bytesread; // bytes handed to the parser
+    size_t rowsparsed;
+    size_t rowskept; // rows that passed the filters in at least one series
+    size_t* dropped; // points dropped per filter plan stage
+    size_t outputbytes;
+};
+
+static double _clock_seconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _stats_start(struct stats* stats)
+{
+    if(stats)
+    {
+        stats->wallstart = _clock_seconds(CLOCK_MONOTONIC);
+        stats->cpustart = _clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    }
+}
+
+// record the time since _stats_start as a stage
+static void _stats_stop(struct stats* stats, const char* name, size_t removed)
+{
+    if(stats && (stats->numstages < MAX_STATS_STAGES))
+    {
+        struct stats_stage* stage = stats->stages + stats->numstages;
+        stage->name = name;
+        stage->wall = _clock_seconds(CLOCK_MONOTONIC) - stats->wallstart;
+        stage->cpu = _clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - stats->cpustart;
+        stage->removed = removed;
+        ++stats->numstages;
+    }
+}
+
+// a step that runs interleaved with others (streaming) only has a counter
+static void _stats_count(struct stats* stats, const char* name, size_t removed)
+{
+    if(stats && (stats->numstages < MAX_STATS_STAGES))
+    {
+        struct stats_stage* stage = stats->stages + stats->numstages;
+        stage->name = name;
+        stage->wall = -1.0;
+        stage->cpu = -1.0;
+        stage->removed = removed;
+        ++stats->numstages;
+    }
+}
+
 static struct filterlist* create_filterlist(void)
 {
     struct filterlist* list = malloc(sizeof(*list));
@@ -90,501 +285,6969 @@ static void destroy_filterlist(struct filterlist* filterlist)
     free(filterlist);
 }
 
-int _apply_filter(struct xydatum* datum, size_t index, struct filter* filter)
+static void _apply_filter(struct datablock* block, struct filter* filter)
 {
     switch(filter->type)
     {
         case FILTER_0_ARG:
-            return filter->func_0_arg(datum, index);
+            filter->func_0_arg(block);
+            break;
         case FILTER_1_ARG:
-            return filter->func_1_arg(datum, index, filter->arg1);
+            filter->func_1_arg(block, filter->arg1);
+            break;
         case FILTER_2_ARG:
-            return filter->func_2_arg(datum, index, filter->arg1, filter->arg2);
+            filter->func_2_arg(block, filter->arg1, filter->arg2);
+            break;
     }
-    return 0;
 }
 
-static void _next_separator(const char* str, const char* separator, const char** startpos, const char** endpos, int* eol)
+static inline __attribute__((always_inline)) void _fused_kernel(struct datablock* block, const struct fused_stage* stage, int prerange, int xaffine, int yaffine, int postrange)
 {
-    const char* pos = str;
-    while(1)
+    for(size_t i = 0; i < block->length; ++i)
     {
-        const char* seppos = separator;
-        if((!*pos) || (*pos == '\n'))
+        double x = block->x[i];
+        unsigned char keep = block->keep[i];
+        if(prerange)
         {
-            *eol = 1;
-            *startpos = pos; // used as terminator for string parsing
-            break;
+            keep = ((x < stage->prexmin) || (x > stage->prexmax)) ? 0 : keep;
         }
-        while(*pos && *seppos && (*pos == *seppos))
+        if(xaffine)
         {
-            *startpos = pos;
-            ++pos;
-            ++seppos;
+            x = x * stage->xscale + stage->xshift;
+            block->x[i] = x;
         }
-        if(!*seppos)
+        if(yaffine)
         {
-            if(!*pos)
-            {
-                *eol = 1;
-            }
-            break;
+            block->y[i] = block->y[i] * stage->yscale + stage->yshift;
         }
-        ++pos;
+        if(postrange)
+        {
+            keep = ((x < stage->postxmin) || (x > stage->postxmax)) ? 0 : keep;
+        }
+        block->keep[i] = keep;
     }
-    *endpos = pos - 1;
 }
 
-static double _str_to_number(const char* str, const char* endptr)
+#define FUSED_KERNEL(shape) \
+    static void _fused_kernel_##shape(struct datablock* block, const struct fused_stage* stage) \
+    { \
+        _fused_kernel(block, stage, (shape) & SHAPE_PRE_RANGE, (shape) & SHAPE_X_AFFINE, (shape) & SHAPE_Y_AFFINE, (shape) & SHAPE_POST_RANGE); \
+    }
+
+FUSED_KERNEL(0)
+FUSED_KERNEL(1)
+FUSED_KERNEL(2)
+FUSED_KERNEL(3)
+FUSED_KERNEL(4)
+FUSED_KERNEL(5)
+FUSED_KERNEL(6)
+FUSED_KERNEL(7)
+FUSED_KERNEL(8)
+FUSED_KERNEL(9)
+FUSED_KERNEL(10)
+FUSED_KERNEL(11)
+FUSED_KERNEL(12)
+FUSED_KERNEL(13)
+FUSED_KERNEL(14)
+FUSED_KERNEL(15)
+
+static void (*const _fused_kernels[NUM_SHAPES])(struct datablock*, const struct fused_stage*) = {
+    _fused_kernel_0, _fused_kernel_1, _fused_kernel_2, _fused_kernel_3,
+    _fused_kernel_4, _fused_kernel_5, _fused_kernel_6, _fused_kernel_7,
+    _fused_kernel_8, _fused_kernel_9, _fused_kernel_10, _fused_kernel_11,
+    _fused_kernel_12, _fused_kernel_13, _fused_kernel_14, _fused_kernel_15
+};
+
+static size_t _count_kept(const struct datablock* block)
 {
-    char* tmp = malloc(endptr - str + 1);
-    const char* ptr = str;
-    char* tptr = tmp;
-    while(ptr != endptr)
+    size_t kept = 0;
+    for(size_t i = 0; i < block->length; ++i)
     {
-        *tptr = *ptr;
-        ++ptr;
-        ++tptr;
+        kept += block->keep[i];
     }
-    *tptr = 0;
-    double num = atof(tmp);
-    free(tmp);
-    return num;
+    return kept;
 }
 
-static struct data* read_data(const char* filename, size_t skip, unsigned int xindex, unsigned int yindex, const char* separator, struct filterlist* filterlist)
+// dropped (one counter per stage) is only given for --stats, a dropped row counts as one point
+// for each of numseries series
+static void _apply_plan(struct datablock* block, const struct filterplan* plan, size_t* dropped, size_t numseries)
 {
-    FILE* file = fopen(filename, "r");
-    if(!file)
+    size_t kept = dropped ? _count_kept(block) : 0;
+    for(size_t i = 0; i < plan->size; ++i)
     {
-        fprintf(stderr, "filter_data: could not open file '%s'\n", filename);
-        return NULL;
-    }
-    char buf[BUFSIZE];
-    struct data* data = malloc(sizeof(*data));
-    data->capacity = 1024;
-    data->data = malloc(sizeof(*data->data) * data->capacity);
-    data->length = 0;
-    size_t numlines = 0;
-    while(1) /* iterate lines */
-    {
-        const char* s = fgets(buf, BUFSIZE, file);
-        ++numlines;
-        if((numlines - 1) < skip)
-        {
-            continue;
-        }
-        if(!s)
+        const struct filterstage* stage = plan->stages + i;
+        switch(stage->type)
         {
-            break;
+            case STAGE_FILTER:
+                _apply_filter(block, stage->filter);
+                break;
+            case STAGE_FUSED:
+                _fused_kernels[stage->fused.shape](block, &stage->fused);
+                break;
         }
-        const char* str = buf;
-        size_t index = 0;
-        if(data->length == data->capacity)
+        if(dropped)
         {
-            data->capacity *= 2;
-            data->data = realloc(data->data, sizeof(*data->data) * data->capacity);
+            size_t now = _count_kept(block);
+            dropped[i] += (kept - now) * numseries;
+            kept = now;
         }
-        struct xydatum* datum = data->data + data->length;
-        datum->deleted = 0;
-        int advance = 1;
-        while(1) /* parse line */
+    }
+}
+
+// only the y transformations of the plan, for the further series of a block whose x values
+// and keep flags were already filtered with the first one
+static void _apply_y_plan(struct datablock* block, const struct filterplan* plan)
+{
+    for(size_t i = 0; i < plan->size; ++i)
+    {
+        const struct filterstage* stage = plan->stages + i;
+        switch(stage->type)
         {
-            int eol = 0;
-            const char* startpos;
-            const char* endpos;
-            _next_separator(str, separator, &startpos, &endpos, &eol);
-            if(index == xindex)
-            {
-                datum->x = _str_to_number(str, startpos);
-            }
-            if(index == yindex)
-            {
-                datum->y.d = _str_to_number(str, startpos);
-                datum->y.type = REAL;
-            }
-            if(eol)
-            {
-                for(size_t i = 0; i < filterlist->size; ++i)
+            case STAGE_FILTER:
+                if(stage->yonly)
                 {
-                    advance = advance && _apply_filter(datum, index, filterlist->filter[i]);
+                    _apply_filter(block, stage->filter);
+                }
+                break;
+            case STAGE_FUSED:
+                if(stage->fused.shape & SHAPE_Y_AFFINE)
+                {
+                    _fused_kernels[SHAPE_Y_AFFINE](block, &stage->fused);
                 }
                 break;
-            }
-            str = endpos + 1;
-            ++index;
-        }
-        if(advance)
-        {
-            ++data->length;
         }
     }
-    fclose(file);
-    return data;
 }
 
-static int _scale_x(struct xydatum* datum, size_t index, void* factor)
-{
-    (void)index;
-    datum->x *= *((double*)factor);
-    return 1;
-}
+// input data is either mapped directly from the file or, for pipes and other
+// files that can't be mapped, read completely into memory
+struct input {
+    const char* data;
+    size_t size;
+    int mapped;
+};
 
-static int _scale_y(struct xydatum* datum, size_t index, void* factor)
+static int _read_all(int fd, struct input* input)
 {
-    (void)index;
-    datum->y.d *= *((double*)factor);
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t size = 0;
+    char* buf = malloc(capacity);
+    while(1)
+    {
+        if(size == capacity)
+        {
+            capacity *= 2;
+            buf = realloc(buf, capacity);
+        }
+        ssize_t ret = read(fd, buf + size, capacity - size);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            free(buf);
+            return 0;
+        }
+        if(ret == 0)
+        {
+            break;
+        }
+        size += ret;
+    }
+    input->data = buf;
+    input->size = size;
+    input->mapped = 0;
     return 1;
 }
 
-static int _x_min(struct xydatum* datum, size_t index, void* min)
+static struct input* open_input(const char* filename)
 {
-    (void)index;
-    if(datum->x < *((double*)min))
+    int usestdin = strcmp(filename, "-") == 0;
+    int fd = usestdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if(fd < 0)
     {
-        return 0;
+        fprintf(stderr, "filter_data: could not open file '%s'\n", filename);
+        return NULL;
     }
-    else
+    struct input* input = malloc(sizeof(*input));
+    struct stat st;
+    if((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0))
     {
-        return 1;
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED)
+        {
+            // data is parsed front to back exactly once
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            madvise(map, st.st_size, MADV_WILLNEED);
+            input->data = map;
+            input->size = st.st_size;
+            input->mapped = 1;
+            if(!usestdin)
+            {
+                close(fd);
+            }
+            return input;
+        }
     }
-}
-
-static int _x_max(struct xydatum* datum, size_t index, void* min)
-{
-    (void)index;
-    if(datum->x > *((double*)min))
+    if(!_read_all(fd, input))
     {
-        return 0;
+        fprintf(stderr, "filter_data: could not read file '%s'\n", filename);
+        free(input);
+        if(!usestdin)
+        {
+            close(fd);
+        }
+        return NULL;
     }
-    else
+    if(!usestdin)
     {
-        return 1;
+        close(fd);
     }
+    return input;
 }
 
-static int _shift_x(struct xydatum* datum, size_t index, void* shift)
-{
-    (void)index;
-    datum->x += *((double*)shift);
-    return 1;
-}
-
-static int _shift_y(struct xydatum* datum, size_t index, void* shift)
-{
-    (void)index;
-    datum->y.d += *((double*)shift);
-    return 1;
-}
-
-static int _y_is_integer(struct xydatum* datum, size_t index)
-{
-    (void)index;
-    datum->y.i += (int) datum->y.d;
-    datum->y.type = INTEGER;
-    return 1;
-}
-
-static int _every_nth(struct xydatum* datum, size_t index, void* nthp)
+static void close_input(struct input* input)
 {
-    (void)index;
-    (void)datum;
-    int nth = *((int*)nthp);
-    if((index % nth) == 0)
+    if(input->mapped)
     {
-        return 1;
+        munmap((void*)input->data, input->size);
     }
     else
     {
-        return 0;
+        free((void*)input->data);
     }
+    free(input);
 }
 
-static struct filter* _create_filter_0_arg(filter_func_0_arg func)
-{
-    struct filter* filter = malloc(sizeof(*filter));
-    filter->func_0_arg = func;
-    filter->type = FILTER_0_ARG;
-    return filter;
-}
-
-static struct filter* _create_filter_1_arg(filter_func_1_arg func, void* arg)
-{
-    struct filter* filter = malloc(sizeof(*filter));
-    filter->func_1_arg = func;
-    filter->type = FILTER_1_ARG;
-    filter->arg1 = arg;
-    return filter;
-}
+// streamed and compressed inputs
+// a source delivers the bytes of a file or of standard input in order. gzip and zstd data is
+// detected by its magic bytes and inflated on a separate thread into a ring of buffers, so
+// decompression and parsing run concurrently
+enum compression {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD
+};
 
-static struct filter* _create_filter_2_arg(filter_func_2_arg func, void* arg1, void* arg2)
-{
-    struct filter* filter = malloc(sizeof(*filter));
-    filter->func_2_arg = func;
-    filter->type = FILTER_2_ARG;
-    filter->arg1 = arg1;
-    filter->arg2 = arg2;
-    return filter;
-}
+// --follow: the input is a file that is still being written. At its end the reader waits for the
+// file to grow (inotify, polling if inotify is not available) instead of stopping. A trailing
+// partial line is only parsed once it is complete, so the consumed offset always ends at a line
+// boundary and can be saved in a checkpoint together with the pipeline state
+struct follow {
+    int inotify; // -1: polling
+    double timeout; // stop after this many seconds without new data, 0: never
+    size_t skip;
+    const char* checkpoint; // NULL: no checkpoint
+    struct pipeline* pipeline; // its state is saved in the checkpoint
+    struct stat filestat; // identity of the followed file
+    // position of the reader, restored from the checkpoint
+    size_t offset; // end of the last processed line
+    size_t row;
+    size_t skipped;
+    uint64_t settings; // hash of the options, a checkpoint is only resumed with the same ones
+};
 
-static void _append_filter(struct filterlist* filterlist, struct filter* filter)
-{
-    filterlist->filter = realloc(filterlist->filter, (filterlist->size + 1) * sizeof(*filterlist->filter));
-    filterlist->filter[filterlist->size] = filter;
-    ++filterlist->size;
-}
+struct source {
+    const char* filename;
+    int fd;
+    int usestdin;
+    unsigned char magic[4]; // bytes read for the format detection, they are delivered first
+    size_t magiclength;
+    size_t magicpos;
+    enum compression compression;
+    struct decompressor* decompressor;
+    struct follow* follow; // set if the file is still being written
+};
 
-static void _usage(void)
-{
-    puts("Filter simulation data");
-    puts("    <filename> (string)                  filename of data");
-    puts("    <xindex> (number)                    index of x data");
-    puts("    <yindex> (number)                    index if y data");
-    puts("    --y-is-integer                       y values are integers, not real numbers");
-    puts("    -s,--separator (default \",\")         input data separator");
-    puts("    -S,--print-separator (default \" \")   output data separator");
-    puts("    -k,--skip                            number of initial lines (header) to skip");
-    puts("    -r,--remove-redundant-points         remove points that add lines to output data, but not numerically (e.g. 42.2 and 42.2 as x coordinates for consecutive points)");
-    puts("    --sample                             take samples of the input data. Use with --sample-start and --sample-interval");
-    puts("    --sample                             take samples of the input data. Use with --sample-start and --sample-interval");
-    puts("    --sample-start                       start of sampling (x-coordinate)");
-    puts("    --sample-interval                    interval of sampling (x-coordinate)");
-    //puts("    -f,--filter                          filter data (remove redundant points)");
-    //puts("    -n,--every-nth (default 1)           only keep every nth point");
-    //puts("    --as-string                          don't do any numerical processing on y");
-    //puts("    --digital                            interpret data as digital data, use with --threshold");
-    //puts("    --threshold (default 0.0)            threshold for digital data");
-    //puts("    --xstart (default -1e32)             minimum x datum");
-    //puts("    --xend (default 1e32)                maximum x datum");
-    //puts("    --xscale (default 1)                 factor for scaling x data");
-    //puts("    --yscale (default 1)                 factor for scaling y data");
-    //puts("    --y-is-multibit                      map binary data (e.g. 101) to decimal (e.g. 5) (implies --as-string)");
-    //puts("    --ymin (default 0)                   minimum value for y map range");
-    //puts("    --ymax (default 0)                   maximum value for y map range");
-    puts("    --xprecision                         decimal digits for x data");
-    //puts("    --yprecision (default 1e-3)          decimal digits for y data");
-    //puts("    --xshift (default 0)                 shift x values");
-    //puts("    --x-relative                         output relative x values");
-}
+struct decompressor {
+    struct source* source;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    char* buffers[DECOMPRESS_RING_SIZE];
+    size_t lengths[DECOMPRESS_RING_SIZE];
+    size_t head; // next buffer to fill
+    size_t tail; // buffer that is read
+    size_t count; // filled buffers
+    size_t readpos; // position in the tail buffer
+    int eof;
+    int error;
+    int stop;
+};
 
-static int _arg_is(const char* arg, const char* short_arg, const char* long_arg)
+static enum compression _detect_compression(const unsigned char* data, size_t size)
 {
-    if(short_arg && strcmp(arg, short_arg) == 0)
+    if((size >= 2) && (data[0] == 0x1f) && (data[1] == 0x8b))
     {
-        return 1;
+        return COMPRESSION_GZIP;
     }
-    if(long_arg && strcmp(arg, long_arg) == 0)
+    if((size >= 4) && (data[0] == 0x28) && (data[1] == 0xb5) && (data[2] == 0x2f) && (data[3] == 0xfd))
     {
-        return 1;
+        return COMPRESSION_ZSTD;
     }
-    return 0;
+    return COMPRESSION_NONE;
 }
 
-static int _has_arg(int argc, char** argv, const char* short_arg, const char* long_arg)
+static ssize_t _read_raw(struct source* source, void* buf, size_t size)
 {
-    for(int i = 1; i < argc; ++i)
+    if(source->magicpos < source->magiclength)
     {
-        if(_arg_is(argv[i], short_arg, long_arg))
+        size_t length = source->magiclength - source->magicpos;
+        if(length > size)
         {
-            return 1;
+            length = size;
         }
+        memcpy(buf, source->magic + source->magicpos, length);
+        source->magicpos += length;
+        return length;
     }
-    return 0;
-}
-
-static size_t _get_skiplines(int argc, char** argv)
-{
-    for(int i = 1; i < argc; ++i)
+    while(1)
     {
-        if(_arg_is(argv[i], "-k", "--skip"))
+        ssize_t ret = read(source->fd, buf, size);
+        if((ret < 0) && (errno == EINTR))
         {
-            if(i < argc - 1)
-            {
-                return atoi(argv[i + 1]);
-            }
+            continue;
         }
+        return ret;
     }
-    return 0;
 }
 
-static int _get_xdecimals(int argc, char** argv)
+// wait for an empty buffer, NULL if the reader has stopped
+static char* _ring_acquire(struct decompressor* decompressor)
 {
-    for(int i = 1; i < argc; ++i)
+    pthread_mutex_lock(&decompressor->mutex);
+    while((decompressor->count == DECOMPRESS_RING_SIZE) && !decompressor->stop)
     {
-        if(_arg_is(argv[i], NULL, "--xprecision"))
-        {
-            if(i < argc - 1)
-            {
-                return atoi(argv[i + 1]);
-            }
-        }
+        pthread_cond_wait(&decompressor->cond, &decompressor->mutex);
     }
-    return 16;
+    char* buffer = decompressor->stop ? NULL : decompressor->buffers[decompressor->head];
+    pthread_mutex_unlock(&decompressor->mutex);
+    return buffer;
 }
 
-static int _get_ydecimals(int argc, char** argv)
+static void _ring_publish(struct decompressor* decompressor, size_t length)
 {
-    for(int i = 1; i < argc; ++i)
+    pthread_mutex_lock(&decompressor->mutex);
+    decompressor->lengths[decompressor->head] = length;
+    decompressor->head = (decompressor->head + 1) % DECOMPRESS_RING_SIZE;
+    ++decompressor->count;
+    pthread_cond_broadcast(&decompressor->cond);
+    pthread_mutex_unlock(&decompressor->mutex);
+}
+
+static int _inflate_gzip(struct decompressor* decompressor, unsigned char* in)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 15 + 32: maximum window, gzip or zlib header
+    if(inflateInit2(&stream, 15 + 32) != Z_OK)
     {
-        if(_arg_is(argv[i], NULL, "--yprecision"))
+        return 0;
+    }
+    char* out = _ring_acquire(decompressor);
+    stream.next_out = (unsigned char*)out;
+    stream.avail_out = DECOMPRESS_BUFFER_SIZE;
+    int eof = 0;
+    int ended = 0; // the last member is complete
+    int ok = 1;
+    while(out)
+    {
+        if((stream.avail_in == 0) && !eof)
         {
-            if(i < argc - 1)
+            ssize_t ret = _read_raw(decompressor->source, in, READ_CHUNK_SIZE);
+            if(ret < 0)
             {
-                return atoi(argv[i + 1]);
+                ok = 0;
+                break;
             }
+            eof = ret == 0;
+            stream.next_in = in;
+            stream.avail_in = ret;
+        }
+        if((stream.avail_in == 0) && eof)
+        {
+            ok = ended;
+            break;
+        }
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        if(ret == Z_STREAM_END)
+        {
+            // concatenated members are inflated one after another, like gzip -d does
+            ended = 1;
+            inflateReset(&stream);
+        }
+        else if((ret == Z_OK) || (ret == Z_BUF_ERROR))
+        {
+            ended = ended && (ret == Z_BUF_ERROR);
+        }
+        else
+        {
+            // trailing garbage after a complete member is ignored
+            ok = ended;
+            break;
+        }
+        if(stream.avail_out == 0)
+        {
+            _ring_publish(decompressor, DECOMPRESS_BUFFER_SIZE);
+            out = _ring_acquire(decompressor);
+            stream.next_out = (unsigned char*)out;
+            stream.avail_out = DECOMPRESS_BUFFER_SIZE;
         }
     }
-    return 16;
+    if(out && (stream.avail_out < DECOMPRESS_BUFFER_SIZE))
+    {
+        _ring_publish(decompressor, DECOMPRESS_BUFFER_SIZE - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return ok;
 }
 
-static double _get_sample_start(int argc, char** argv)
+#ifdef HAVE_ZSTD
+static int _inflate_zstd(struct decompressor* decompressor, unsigned char* in)
 {
-    for(int i = 1; i < argc; ++i)
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    if(!stream)
     {
-        if(_arg_is(argv[i], NULL, "--sample-start"))
+        return 0;
+    }
+    ZSTD_initDStream(stream);
+    ZSTD_inBuffer input = { in, 0, 0 };
+    ZSTD_outBuffer output = { _ring_acquire(decompressor), DECOMPRESS_BUFFER_SIZE, 0 };
+    int eof = 0;
+    size_t ret = 0; // 0 after a complete frame
+    int ok = 1;
+    while(output.dst)
+    {
+        if((input.pos == input.size) && !eof)
         {
-            if(i < argc - 1)
+            ssize_t length = _read_raw(decompressor->source, in, READ_CHUNK_SIZE);
+            if(length < 0)
             {
-                return atof(argv[i + 1]);
+                ok = 0;
+                break;
             }
+            eof = length == 0;
+            input.size = length;
+            input.pos = 0;
+        }
+        if((input.pos == input.size) && eof && (output.pos < output.size))
+        {
+            ok = ret == 0;
+            break;
+        }
+        ret = ZSTD_decompressStream(stream, &output, &input);
+        if(ZSTD_isError(ret))
+        {
+            ok = 0;
+            break;
+        }
+        if(output.pos == output.size)
+        {
+            _ring_publish(decompressor, output.pos);
+            output.dst = _ring_acquire(decompressor);
+            output.pos = 0;
         }
     }
-    return 0.0;
+    if(output.dst && (output.pos > 0))
+    {
+        _ring_publish(decompressor, output.pos);
+    }
+    ZSTD_freeDStream(stream);
+    return ok;
 }
+#endif
 
-static double _get_sample_interval(int argc, char** argv)
+static void* _decompress_worker(void* arg)
 {
-    for(int i = 1; i < argc; ++i)
+    struct decompressor* decompressor = arg;
+    unsigned char* in = malloc(READ_CHUNK_SIZE);
+    int ok = 0;
+    switch(decompressor->source->compression)
     {
-        if(_arg_is(argv[i], NULL, "--sample-interval"))
+        case COMPRESSION_GZIP:
+            ok = _inflate_gzip(decompressor, in);
+            break;
+        case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+            ok = _inflate_zstd(decompressor, in);
+#endif
+            break;
+        case COMPRESSION_NONE:
+            break;
+    }
+    free(in);
+    pthread_mutex_lock(&decompressor->mutex);
+    if(!ok && !decompressor->stop)
+    {
+        fprintf(stderr, "filter_data: corrupt or truncated compressed data in '%s'\n", decompressor->source->filename);
+    }
+    decompressor->error = !ok;
+    decompressor->eof = 1;
+    pthread_cond_broadcast(&decompressor->cond);
+    pthread_mutex_unlock(&decompressor->mutex);
+    return NULL;
+}
+
+static struct decompressor* _start_decompressor(struct source* source)
+{
+    struct decompressor* decompressor = malloc(sizeof(*decompressor));
+    decompressor->source = source;
+    for(size_t i = 0; i < DECOMPRESS_RING_SIZE; ++i)
+    {
+        decompressor->buffers[i] = malloc(DECOMPRESS_BUFFER_SIZE);
+    }
+    decompressor->head = 0;
+    decompressor->tail = 0;
+    decompressor->count = 0;
+    decompressor->readpos = 0;
+    decompressor->eof = 0;
+    decompressor->error = 0;
+    decompressor->stop = 0;
+    pthread_mutex_init(&decompressor->mutex, NULL);
+    pthread_cond_init(&decompressor->cond, NULL);
+    if(pthread_create(&decompressor->thread, NULL, _decompress_worker, decompressor) != 0)
+    {
+        fputs("filter_data: could not start the decompression thread\n", stderr);
+        for(size_t i = 0; i < DECOMPRESS_RING_SIZE; ++i)
         {
-            if(i < argc - 1)
+            free(decompressor->buffers[i]);
+        }
+        free(decompressor);
+        return NULL;
+    }
+    return decompressor;
+}
+
+static ssize_t _read_decompressed(struct decompressor* decompressor, char* buf, size_t size)
+{
+    pthread_mutex_lock(&decompressor->mutex);
+    while((decompressor->count == 0) && !decompressor->eof)
+    {
+        pthread_cond_wait(&decompressor->cond, &decompressor->mutex);
+    }
+    ssize_t length = 0;
+    if(decompressor->count > 0)
+    {
+        size_t available = decompressor->lengths[decompressor->tail] - decompressor->readpos;
+        length = available < size ? available : size;
+        pthread_mutex_unlock(&decompressor->mutex);
+        // the tail buffer is not touched by the worker until it is released
+        memcpy(buf, decompressor->buffers[decompressor->tail] + decompressor->readpos, length);
+        pthread_mutex_lock(&decompressor->mutex);
+        decompressor->readpos += length;
+        if(decompressor->readpos == decompressor->lengths[decompressor->tail])
+        {
+            decompressor->readpos = 0;
+            decompressor->tail = (decompressor->tail + 1) % DECOMPRESS_RING_SIZE;
+            --decompressor->count;
+            pthread_cond_broadcast(&decompressor->cond);
+        }
+    }
+    else if(decompressor->error)
+    {
+        length = -1;
+    }
+    pthread_mutex_unlock(&decompressor->mutex);
+    return length;
+}
+
+// returns 0 if the data was corrupt
+static int _stop_decompressor(struct decompressor* decompressor)
+{
+    pthread_mutex_lock(&decompressor->mutex);
+    decompressor->stop = 1;
+    pthread_cond_broadcast(&decompressor->cond);
+    pthread_mutex_unlock(&decompressor->mutex);
+    pthread_join(decompressor->thread, NULL);
+    int ok = !decompressor->error;
+    pthread_mutex_destroy(&decompressor->mutex);
+    pthread_cond_destroy(&decompressor->cond);
+    for(size_t i = 0; i < DECOMPRESS_RING_SIZE; ++i)
+    {
+        free(decompressor->buffers[i]);
+    }
+    free(decompressor);
+    return ok;
+}
+
+static ssize_t read_source(struct source* source, char* buf, size_t size)
+{
+    if(source->decompressor)
+    {
+        return _read_decompressed(source->decompressor, buf, size);
+    }
+    return _read_raw(source, buf, size);
+}
+
+// returns 0 if compressed data was corrupt
+static int close_source(struct source* source)
+{
+    int ok = 1;
+    if(source->decompressor)
+    {
+        ok = _stop_decompressor(source->decompressor);
+    }
+    if(!source->usestdin)
+    {
+        close(source->fd);
+    }
+    if(source->follow && (source->follow->inotify >= 0))
+    {
+        close(source->follow->inotify);
+        source->follow->inotify = -1;
+    }
+    free(source);
+    return ok;
+}
+
+static struct source* open_source(const char* filename)
+{
+    int usestdin = strcmp(filename, "-") == 0;
+    int fd = usestdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        fprintf(stderr, "filter_data: could not open file '%s'\n", filename);
+        return NULL;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    struct source* source = malloc(sizeof(*source));
+    source->filename = filename;
+    source->fd = fd;
+    source->usestdin = usestdin;
+    source->magiclength = 0;
+    source->magicpos = 0;
+    source->decompressor = NULL;
+    source->follow = NULL;
+    while(source->magiclength < sizeof(source->magic))
+    {
+        ssize_t ret = _read_raw(source, source->magic + source->magiclength, sizeof(source->magic) - source->magiclength);
+        if(ret <= 0)
+        {
+            break;
+        }
+        source->magiclength += ret;
+    }
+    source->compression = _detect_compression(source->magic, source->magiclength);
+#ifndef HAVE_ZSTD
+    if(source->compression == COMPRESSION_ZSTD)
+    {
+        fprintf(stderr, "filter_data: '%s' is zstd compressed, but filter_data was built without zstd support\n", filename);
+        source->compression = COMPRESSION_NONE;
+        close_source(source);
+        return NULL;
+    }
+#endif
+    if(source->compression != COMPRESSION_NONE)
+    {
+        source->decompressor = _start_decompressor(source);
+        if(!source->decompressor)
+        {
+            close_source(source);
+            return NULL;
+        }
+    }
+    return source;
+}
+
+static int _is_compressed(const struct input* input)
+{
+    return _detect_compression((const unsigned char*)input->data, input->size) != COMPRESSION_NONE;
+}
+
+static volatile sig_atomic_t _follow_stopped = 0;
+
+static void _stop_following(int signum)
+{
+    (void)signum;
+    _follow_stopped = 1;
+}
+
+static void _save_checkpoint(const char* filename, const struct follow* follow);
+
+// returns 0 if following should stop (signal, timeout, file removed or truncated)
+static int _wait_for_data(struct source* source)
+{
+    struct follow* follow = source->follow;
+    double start = _clock_seconds(CLOCK_MONOTONIC);
+    while(!_follow_stopped)
+    {
+        struct stat st;
+        off_t pos = lseek(source->fd, 0, SEEK_CUR);
+        if((fstat(source->fd, &st) != 0) || (pos < 0))
+        {
+            return 0;
+        }
+        if(st.st_size > pos)
+        {
+            return 1;
+        }
+        if(st.st_size < pos)
+        {
+            fprintf(stderr, "filter_data: '%s' was truncated, stopping\n", source->filename);
+            return 0;
+        }
+        if(st.st_nlink == 0)
+        {
+            // removed, nothing will be appended anymore
+            return 0;
+        }
+        if((follow->timeout > 0.0) && (_clock_seconds(CLOCK_MONOTONIC) - start >= follow->timeout))
+        {
+            return 0;
+        }
+        if(follow->inotify >= 0)
+        {
+            // the timeout also catches changes inotify does not report (network file systems)
+            struct pollfd pfd = { .fd = follow->inotify, .events = POLLIN };
+            if(poll(&pfd, 1, FOLLOW_POLL_MS) > 0)
             {
-                return atof(argv[i + 1]);
+                char events[4096];
+                while(read(follow->inotify, events, sizeof(events)) > 0)
+                {
+                }
             }
         }
+        else
+        {
+            struct timespec delay = { .tv_sec = 0, .tv_nsec = FOLLOW_POLL_MS * 1000000L };
+            nanosleep(&delay, NULL);
+        }
     }
-    return 0.0;
+    return 0;
 }
 
-static char* _get_separator(int argc, char** argv, const char* default_sep)
+static struct source* open_follow_source(const char* filename, struct follow* follow)
 {
-    for(int i = 1; i < argc; ++i)
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
     {
-        if(_arg_is(argv[i], "-s", "--separator"))
+        fprintf(stderr, "filter_data: could not open file '%s'\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    unsigned char magic[4];
+    ssize_t length = pread(fd, magic, sizeof(magic), 0);
+    if((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || (length < 0))
+    {
+        fprintf(stderr, "filter_data: --follow needs a regular file, '%s' is none\n", filename);
+        close(fd);
+        return NULL;
+    }
+    if(_detect_compression(magic, length) != COMPRESSION_NONE)
+    {
+        fprintf(stderr, "filter_data: compressed files can't be followed ('%s')\n", filename);
+        close(fd);
+        return NULL;
+    }
+    if((follow->offset > (size_t)st.st_size) || (lseek(fd, follow->offset, SEEK_SET) < 0))
+    {
+        fprintf(stderr, "filter_data: '%s' is shorter than the checkpoint offset\n", filename);
+        close(fd);
+        return NULL;
+    }
+    follow->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if((follow->inotify >= 0) && (inotify_add_watch(follow->inotify, filename, IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0))
+    {
+        close(follow->inotify);
+        follow->inotify = -1;
+    }
+    follow->filestat = st;
+    struct source* source = malloc(sizeof(*source));
+    source->filename = filename;
+    source->fd = fd;
+    source->usestdin = 0;
+    source->magiclength = 0;
+    source->magicpos = 0;
+    source->compression = COMPRESSION_NONE;
+    source->decompressor = NULL;
+    source->follow = follow;
+    return source;
+}
+
+// field scanning
+// separators are searched 16 (SSE2) or 32 (AVX2, if the cpu has it) bytes at a time. To get to
+// a column further right, the separators in a whole vector are counted at once, so the fields
+// in between are never looked at. Multi-character separators are searched by their first
+// character, every candidate is compared in full. Nothing is read behind the end of the line
+#if defined(__x86_64__)
+#define HAVE_SSE2_SCANNER
+#endif
+
+// position of the count-th c (count >= 1) in [str, end) or NULL
+static const char* _skip_chars_scalar(const char* str, const char* end, char c, size_t count)
+{
+    for(; str < end; ++str)
+    {
+        if((*str == c) && (--count == 0))
         {
-            if(i < argc - 1)
+            return str;
+        }
+    }
+    return NULL;
+}
+
+#ifdef HAVE_SSE2_SCANNER
+// the count-th set bit of mask (count <= popcount)
+static unsigned int _nth_bit(uint32_t mask, size_t count)
+{
+    while(--count > 0)
+    {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+static const char* _skip_chars_sse2(const char* str, const char* end, char c, size_t count)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    while(end - str >= 16)
+    {
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)str), needle));
+        size_t found = __builtin_popcount(mask);
+        if(found >= count)
+        {
+            return str + _nth_bit(mask, count);
+        }
+        count -= found;
+        str += 16;
+    }
+    return _skip_chars_scalar(str, end, c, count);
+}
+
+__attribute__((target("avx2")))
+static const char* _skip_chars_avx2(const char* str, const char* end, char c, size_t count)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    while(end - str >= 32)
+    {
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)str), needle));
+        size_t found = __builtin_popcount(mask);
+        if(found >= count)
+        {
+            return str + _nth_bit(mask, count);
+        }
+        count -= found;
+        str += 32;
+    }
+    return _skip_chars_sse2(str, end, c, count);
+}
+#endif
+
+typedef const char* (*skip_chars_func)(const char* str, const char* end, char c, size_t count);
+
+#ifdef HAVE_SSE2_SCANNER
+static skip_chars_func _skip_chars = _skip_chars_sse2;
+#else
+static skip_chars_func _skip_chars = _skip_chars_scalar;
+#endif
+
+// picks the widest variant the cpu supports, before that the baseline variant is used
+static void _init_field_scanner(void)
+{
+#ifdef HAVE_SSE2_SCANNER
+    __builtin_cpu_init();
+    _skip_chars = __builtin_cpu_supports("avx2") ? _skip_chars_avx2 : _skip_chars_sse2;
+#else
+    _skip_chars = _skip_chars_scalar;
+#endif
+}
+
+// start of the count-th separator (count >= 1) in [str, end) or NULL
+static const char* _skip_separators(const char* str, const char* end, const char* separator, size_t seplen, size_t count)
+{
+    if(seplen == 1)
+    {
+        return _skip_chars(str, end, *separator, count);
+    }
+    while(1)
+    {
+        const char* pos = end - str >= (ptrdiff_t)seplen ? _skip_chars(str, end - seplen + 1, *separator, 1) : NULL;
+        if(!pos)
+        {
+            return NULL;
+        }
+        if(memcmp(pos, separator, seplen) == 0)
+        {
+            if(--count == 0)
             {
-                return strdup(argv[i + 1]);
+                return pos;
             }
+            str = pos + seplen;
+        }
+        else
+        {
+            str = pos + 1;
         }
     }
-    return strdup(default_sep);
 }
 
-static char* _get_print_separator(int argc, char** argv, const char* default_sep)
+// find the end of the field starting at str, end is the end of the line (excluding the newline)
+// returns the start of the next field or NULL if this is the last field of the line
+static const char* _next_separator(const char* str, const char* end, const char* separator, size_t seplen, const char** fieldend)
 {
-    for(int i = 1; i < argc; ++i)
+    const char* pos = _skip_separators(str, end, separator, seplen, 1);
+    if(!pos)
+    {
+        *fieldend = end;
+        return NULL;
+    }
+    *fieldend = pos;
+    return pos + seplen;
+}
+
+// start of the field count fields after the one starting at str or NULL if the line is shorter
+static const char* _skip_fields(const char* str, const char* end, const char* separator, size_t seplen, size_t count)
+{
+    if(count == 0)
+    {
+        return str;
+    }
+    const char* pos = _skip_separators(str, end, separator, seplen, count);
+    return pos ? pos + seplen : NULL;
+}
+
+// number parsing
+// fields are parsed in place with the Eisel-Lemire algorithm, which yields correctly rounded
+// results for up to 19 significant digits. The 128-bit truncated powers of five it needs are
+// generated once at startup. Everything the fast path can't decide (more digits, subnormals,
+// inf/nan, hex floats) is passed to strtod on a stack copy of the field.
+#define POW5_MIN_EXPONENT (-342)
+#define POW5_MAX_EXPONENT 308
+#define POW5_BIGNUM_BITS 1760
+#define POW5_BIGNUM_LIMBS (POW5_BIGNUM_BITS / 32)
+
+static uint64_t _pow5_table[2 * (POW5_MAX_EXPONENT - POW5_MIN_EXPONENT + 1)];
+static int _pow5_table_initialized = 0;
+
+static size_t _big_bitlength(const uint32_t* big)
+{
+    for(size_t i = POW5_BIGNUM_LIMBS; i > 0; --i)
+    {
+        if(big[i - 1])
+        {
+            return (i - 1) * 32 + 32 - __builtin_clz(big[i - 1]);
+        }
+    }
+    return 0;
+}
+
+static int _big_bit(const uint32_t* big, size_t pos)
+{
+    return (big[pos / 32] >> (pos % 32)) & 1;
+}
+
+// bits [pos, pos + 128) of big, bits beyond the end are zero, negative positions shift in zeros
+static unsigned __int128 _big_bits(const uint32_t* big, long pos)
+{
+    unsigned __int128 result = 0;
+    for(long i = 127; i >= 0; --i)
+    {
+        long bit = pos + i;
+        result <<= 1;
+        if((bit >= 0) && (bit < POW5_BIGNUM_BITS))
+        {
+            result |= _big_bit(big, bit);
+        }
+    }
+    return result;
+}
+
+static void _big_mul_small(uint32_t* big, uint32_t factor)
+{
+    uint64_t carry = 0;
+    for(size_t i = 0; i < POW5_BIGNUM_LIMBS; ++i)
+    {
+        uint64_t v = (uint64_t)big[i] * factor + carry;
+        big[i] = (uint32_t)v;
+        carry = v >> 32;
+    }
+}
+
+static void _big_div_small(uint32_t* big, uint32_t divisor)
+{
+    uint64_t rem = 0;
+    for(size_t i = POW5_BIGNUM_LIMBS; i > 0; --i)
+    {
+        uint64_t v = (rem << 32) | big[i - 1];
+        big[i - 1] = (uint32_t)(v / divisor);
+        rem = v % divisor;
+    }
+}
+
+static void _set_pow5_entry(int q, unsigned __int128 value)
+{
+    size_t index = 2 * (q - POW5_MIN_EXPONENT);
+    _pow5_table[index] = (uint64_t)(value >> 64);
+    _pow5_table[index + 1] = (uint64_t)value;
+}
+
+static void _init_number_parser(void)
+{
+    if(_pow5_table_initialized)
+    {
+        return;
+    }
+    uint32_t power[POW5_BIGNUM_LIMBS] = { 0 };      // 5^q
+    uint32_t reciprocal[POW5_BIGNUM_LIMBS] = { 0 }; // floor(2^(POW5_BIGNUM_BITS - 1) / 5^q)
+    power[0] = 1;
+    reciprocal[POW5_BIGNUM_LIMBS - 1] = 1u << 31;
+    for(int q = 0; q <= -POW5_MIN_EXPONENT; ++q)
+    {
+        size_t z = _big_bitlength(power); // 5^q is never a power of two (q > 0), so 2^z > 5^q
+        if(q <= POW5_MAX_EXPONENT)
+        {
+            // most significant 128 bits, truncated
+            _set_pow5_entry(q, _big_bits(power, (long)z - 128));
+        }
+        if(q > 0)
+        {
+            // floor(2^b / 5^q) + 1, truncated to 128 bits
+            long b = (q <= 27) ? (long)z + 127 : 2 * (long)z + 128;
+            long shift = (POW5_BIGNUM_BITS - 1) - b;
+            size_t length = _big_bitlength(reciprocal) - shift;
+            long truncate = length > 128 ? (long)length - 128 : 0;
+            unsigned __int128 value = _big_bits(reciprocal, shift + truncate);
+            int carry = 1;
+            for(long i = 0; i < truncate; ++i)
+            {
+                if(!_big_bit(reciprocal, shift + i))
+                {
+                    carry = 0;
+                    break;
+                }
+            }
+            if(carry)
+            {
+                value += 1;
+                if(value == 0)
+                {
+                    value = (unsigned __int128)1 << 127;
+                }
+            }
+            _set_pow5_entry(-q, value);
+        }
+        _big_mul_small(power, 5);
+        _big_div_small(reciprocal, 5);
+    }
+    _pow5_table_initialized = 1;
+}
+
+static const double _exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// w * 10^q, returns 0 if the result can't be determined exactly
+static int _compute_float(uint64_t w, long q, int negative, double* result)
+{
+    if((w <= (1ull << 53)) && (q >= -22) && (q <= 22))
+    {
+        double d = (double)w;
+        d = q < 0 ? d / _exact_powers_of_ten[-q] : d * _exact_powers_of_ten[q];
+        *result = negative ? -d : d;
+        return 1;
+    }
+    if((w == 0) || (q < POW5_MIN_EXPONENT))
+    {
+        *result = negative ? -0.0 : 0.0;
+        return 1;
+    }
+    if(q > POW5_MAX_EXPONENT)
+    {
+        return 0;
+    }
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    size_t index = 2 * (q - POW5_MIN_EXPONENT);
+    unsigned __int128 first = (unsigned __int128)w * _pow5_table[index];
+    uint64_t high = (uint64_t)(first >> 64);
+    uint64_t low = (uint64_t)first;
+    if((high & 0x1FF) == 0x1FF)
+    {
+        unsigned __int128 second = (unsigned __int128)w * _pow5_table[index + 1];
+        uint64_t secondhigh = (uint64_t)(second >> 64);
+        low += secondhigh;
+        if(secondhigh > low)
+        {
+            ++high;
+        }
+    }
+    if((low == 0xFFFFFFFFFFFFFFFF) && ((q < -27) || (q > 55)))
+    {
+        return 0;
+    }
+    int upperbit = (int)(high >> 63);
+    int shift = upperbit + 9;
+    uint64_t mantissa = high >> shift;
+    long power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz + 1023;
+    if(power2 <= 0)
+    {
+        return 0; // subnormal
+    }
+    // halfway between two doubles: round to even
+    if((low <= 1) && (q >= -4) && (q <= 23) && ((mantissa & 3) == 1) && ((mantissa << shift) == high))
+    {
+        mantissa &= ~(uint64_t)1;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if(mantissa >= (2ull << 52))
+    {
+        mantissa = 1ull << 52;
+        ++power2;
+    }
+    mantissa &= ~(1ull << 52);
+    if(power2 >= 0x7FF)
+    {
+        return 0; // infinity
+    }
+    uint64_t bits = mantissa | ((uint64_t)power2 << 52) | ((uint64_t)negative << 63);
+    memcpy(result, &bits, sizeof(bits));
+    return 1;
+}
+
+static double _str_to_number_fallback(const char* str, const char* endptr)
+{
+    char buf[128];
+    size_t length = endptr - str;
+    char* tmp = length < sizeof(buf) ? buf : malloc(length + 1);
+    memcpy(tmp, str, length);
+    tmp[length] = 0;
+    double num = strtod(tmp, NULL);
+    if(tmp != buf)
+    {
+        free(tmp);
+    }
+    return num;
+}
+
+static int _is_digit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+static double _str_to_number(const char* str, const char* endptr)
+{
+    const char* pos = str;
+    while((pos < endptr) && ((*pos == ' ') || ((unsigned char)(*pos - '\t') < 5)))
+    {
+        ++pos;
+    }
+    int negative = 0;
+    if((pos < endptr) && ((*pos == '-') || (*pos == '+')))
+    {
+        negative = *pos == '-';
+        ++pos;
+    }
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int numdigits = 0;
+    long exponent = 0;
+    while((pos < endptr) && _is_digit(*pos))
+    {
+        if(mantissa || (*pos != '0'))
+        {
+            ++significant;
+        }
+        mantissa = mantissa * 10 + (*pos - '0');
+        ++numdigits;
+        ++pos;
+    }
+    if((pos < endptr) && (*pos == '.'))
+    {
+        ++pos;
+        while((pos < endptr) && _is_digit(*pos))
+        {
+            if(mantissa || (*pos != '0'))
+            {
+                ++significant;
+            }
+            mantissa = mantissa * 10 + (*pos - '0');
+            ++numdigits;
+            --exponent;
+            ++pos;
+        }
+    }
+    if((numdigits == 0) || (significant > 19))
+    {
+        // inf, nan, garbage or too many digits
+        return _str_to_number_fallback(str, endptr);
+    }
+    if(pos < endptr)
+    {
+        if((*pos == 'e') || (*pos == 'E'))
+        {
+            const char* epos = pos + 1;
+            int enegative = 0;
+            if((epos < endptr) && ((*epos == '-') || (*epos == '+')))
+            {
+                enegative = *epos == '-';
+                ++epos;
+            }
+            if((epos < endptr) && _is_digit(*epos))
+            {
+                long e = 0;
+                while((epos < endptr) && _is_digit(*epos))
+                {
+                    if(e < 100000)
+                    {
+                        e = e * 10 + (*epos - '0');
+                    }
+                    ++epos;
+                }
+                exponent += enegative ? -e : e;
+            }
+        }
+        else if(((*pos == 'x') || (*pos == 'X')) && (numdigits == 1))
+        {
+            // hexadecimal
+            return _str_to_number_fallback(str, endptr);
+        }
+    }
+    double result;
+    if(!_compute_float(mantissa, exponent, negative, &result))
+    {
+        return _str_to_number_fallback(str, endptr);
+    }
+    return result;
+}
+
+// string data
+// field bytes are copied into an arena, every distinct string is stored exactly once
+// (interned), so equal strings are equal pointers. Every string is preceded by its symbol
+// number, which is what the parser passes through the blocks as y value. Bus values
+// (--y-is-multibit) are decoded once per symbol
+struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct arena {
+    struct arena_chunk* chunk;
+};
+
+static void* _arena_alloc(struct arena* arena, size_t size)
+{
+    struct arena_chunk* chunk = arena->chunk;
+    if(!chunk || (chunk->size - chunk->used < size))
+    {
+        size_t chunksize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        chunk = malloc(sizeof(*chunk) + chunksize);
+        chunk->next = arena->chunk;
+        chunk->size = chunksize;
+        chunk->used = 0;
+        arena->chunk = chunk;
+    }
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+static void _arena_free(struct arena* arena)
+{
+    struct arena_chunk* chunk = arena->chunk;
+    while(chunk)
+    {
+        struct arena_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunk = NULL;
+}
+
+struct symboltable {
+    struct arena arena;
+    const char** names; // by symbol number
+    int* values; // decoded bus values by symbol number (only for multibit tables)
+    size_t numsymbols;
+    size_t symbolcapacity;
+    uint32_t* slots; // hash table of symbol number + 1, 0 is empty
+    uint64_t* hashes;
+    size_t numslots;
+    int multibit;
+};
+
+static void destroy_symboltable(struct symboltable* table)
+{
+    _arena_free(&table->arena);
+    free(table->names);
+    free(table->values);
+    free(table->hashes);
+    free(table->slots);
+    free(table);
+}
+
+static uint64_t _hash_string(const char* str, size_t length)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (unsigned char)str[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint32_t _symbol_number(const char* name)
+{
+    uint32_t number;
+    memcpy(&number, name - sizeof(number), sizeof(number));
+    return number;
+}
+
+// binary digits, an optional leading b is skipped, all other characters count as 0
+static int _decode_multibit(const char* str, size_t length)
+{
+    size_t i = 0;
+    if((length > 0) && ((str[0] == 'b') || (str[0] == 'B')))
+    {
+        i = 1;
+    }
+    unsigned int value = 0;
+    for(; i < length; ++i)
+    {
+        value = (value << 1) | (str[i] == '1');
+    }
+    return (int)value;
+}
+
+static void _grow_slots(struct symboltable* table)
+{
+    size_t numslots = 2 * table->numslots;
+    uint32_t* slots = calloc(numslots, sizeof(*slots));
+    for(size_t i = 0; i < table->numsymbols; ++i)
+    {
+        size_t slot = table->hashes[i] & (numslots - 1);
+        while(slots[slot])
+        {
+            slot = (slot + 1) & (numslots - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->numslots = numslots;
+}
+
+static uint32_t intern_symbol(struct symboltable* table, const char* str, size_t length)
+{
+    uint64_t hash = _hash_string(str, length);
+    size_t slot = hash & (table->numslots - 1);
+    while(table->slots[slot])
+    {
+        uint32_t number = table->slots[slot] - 1;
+        const char* name = table->names[number];
+        if((table->hashes[number] == hash) && (strncmp(name, str, length) == 0) && (name[length] == 0))
+        {
+            return number;
+        }
+        slot = (slot + 1) & (table->numslots - 1);
+    }
+    uint32_t number = table->numsymbols;
+    if(number == table->symbolcapacity)
+    {
+        table->symbolcapacity *= 2;
+        table->names = realloc(table->names, sizeof(*table->names) * table->symbolcapacity);
+        table->hashes = realloc(table->hashes, sizeof(*table->hashes) * table->symbolcapacity);
+        if(table->values)
+        {
+            table->values = realloc(table->values, sizeof(*table->values) * table->symbolcapacity);
+        }
+    }
+    char* name = (char*)_arena_alloc(&table->arena, sizeof(number) + length + 1) + sizeof(number);
+    memcpy(name - sizeof(number), &number, sizeof(number));
+    memcpy(name, str, length);
+    name[length] = 0;
+    table->names[number] = name;
+    table->hashes[number] = hash;
+    if(table->values)
+    {
+        table->values[number] = _decode_multibit(str, length);
+    }
+    table->slots[slot] = number + 1;
+    ++table->numsymbols;
+    if(2 * table->numsymbols > table->numslots)
+    {
+        _grow_slots(table);
+    }
+    return number;
+}
+
+static struct symboltable* create_symboltable(int multibit)
+{
+    struct symboltable* table = malloc(sizeof(*table));
+    table->arena.chunk = NULL;
+    table->symbolcapacity = 64;
+    table->numsymbols = 0;
+    table->names = calloc(table->symbolcapacity, sizeof(*table->names));
+    table->values = multibit ? malloc(sizeof(*table->values) * table->symbolcapacity) : NULL;
+    table->hashes = calloc(table->symbolcapacity, sizeof(*table->hashes));
+    table->numslots = 128;
+    table->slots = calloc(table->numslots, sizeof(*table->slots));
+    table->multibit = multibit;
+    // symbol 0 is the empty string, it stands for missing fields
+    intern_symbol(table, "", 0);
+    return table;
+}
+
+static size_t _bitmap_words(size_t bits)
+{
+    return (bits + 63) / 64;
+}
+
+// single precision storage for real y values is used if yfloatdecimals >= 0 and as long
+// as it doesn't change any printed digit at this precision
+static struct data* _create_data(size_t capacity, size_t numseries, enum ytype ytype, int yfloatdecimals)
+{
+    struct data* data = malloc(sizeof(*data));
+    data->capacity = capacity > 0 ? capacity : 1;
+    data->length = 0;
+    data->x = malloc(sizeof(*data->x) * data->capacity);
+    data->numseries = numseries;
+    data->series = malloc(sizeof(*data->series) * numseries);
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        struct series* series = data->series + s;
+        series->ytype = ytype;
+        series->yfloat = (ytype == REAL) && (yfloatdecimals >= 0);
+        series->yfloatscale = pow(10, yfloatdecimals);
+        switch(series->ytype)
+        {
+            case REAL:
+                if(series->yfloat)
+                {
+                    series->y.f = malloc(sizeof(*series->y.f) * data->capacity);
+                }
+                else
+                {
+                    series->y.d = malloc(sizeof(*series->y.d) * data->capacity);
+                }
+                break;
+            case INTEGER:
+                series->y.i = malloc(sizeof(*series->y.i) * data->capacity);
+                break;
+            case STRING:
+                series->y.str = malloc(sizeof(*series->y.str) * data->capacity);
+                break;
+        }
+        series->deleted = calloc(_bitmap_words(data->capacity), sizeof(*series->deleted));
+    }
+    data->input = NULL;
+    data->symbols = NULL;
+    return data;
+}
+
+static void _destroy_data(struct data* data)
+{
+    if(data->input)
+    {
+        close_input(data->input);
+    }
+    else
+    {
+        free(data->x);
+        for(size_t s = 0; s < data->numseries; ++s)
+        {
+            free(data->series[s].y.d);
+        }
+    }
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        free(data->series[s].deleted);
+    }
+    if(data->symbols)
+    {
+        destroy_symboltable(data->symbols);
+    }
+    free(data->series);
+    free(data);
+}
+
+static size_t _ysize(const struct series* series)
+{
+    switch(series->ytype)
+    {
+        case REAL:
+            return series->yfloat ? sizeof(*series->y.f) : sizeof(*series->y.d);
+        case INTEGER:
+            return sizeof(*series->y.i);
+        case STRING:
+            return sizeof(*series->y.str);
+    }
+    return 0;
+}
+
+static void _reserve_data(struct data* data, size_t capacity)
+{
+    if(capacity <= data->capacity)
+    {
+        return;
+    }
+    if(capacity < 2 * data->capacity)
+    {
+        capacity = 2 * data->capacity;
+    }
+    size_t oldwords = _bitmap_words(data->capacity);
+    size_t newwords = _bitmap_words(capacity);
+    if(data->input)
+    {
+        // detach from the mapped input
+        double* x = malloc(sizeof(*x) * capacity);
+        memcpy(x, data->x, sizeof(*x) * data->length);
+        data->x = x;
+        for(size_t s = 0; s < data->numseries; ++s)
+        {
+            struct series* series = data->series + s;
+            void* y = malloc(_ysize(series) * capacity);
+            memcpy(y, series->y.d, _ysize(series) * data->length);
+            series->y.d = y;
+        }
+        close_input(data->input);
+        data->input = NULL;
+    }
+    else
+    {
+        data->x = realloc(data->x, sizeof(*data->x) * capacity);
+        for(size_t s = 0; s < data->numseries; ++s)
+        {
+            struct series* series = data->series + s;
+            series->y.d = realloc(series->y.d, _ysize(series) * capacity);
+        }
+    }
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        struct series* series = data->series + s;
+        series->deleted = realloc(series->deleted, sizeof(*series->deleted) * newwords);
+        memset(series->deleted + oldwords, 0, sizeof(*series->deleted) * (newwords - oldwords));
+    }
+    data->capacity = capacity;
+}
+
+// switch single precision y storage back to double precision
+static void _promote_y(struct data* data, struct series* series)
+{
+    double* y = malloc(sizeof(*y) * data->capacity);
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        y[i] = series->y.f[i];
+    }
+    if(!data->input)
+    {
+        free(series->y.f);
+    }
+    series->y.d = y;
+    series->yfloat = 0;
+}
+
+static void _store_y(struct data* data, struct series* series, size_t i, double y)
+{
+    switch(series->ytype)
+    {
+        case REAL:
+            if(series->yfloat)
+            {
+                float f = (float)y;
+                double error = fabs(y - f);
+                // the rounding error has to be small and must not move the value across a rounding boundary
+                double scaled = y * series->yfloatscale;
+                double boundary = fabs(scaled - floor(scaled) - 0.5) / series->yfloatscale;
+                if((error == 0.0) || ((error * series->yfloatscale <= 0.01) && (boundary > 2 * error + 4 * DBL_EPSILON * fabs(y))))
+                {
+                    series->y.f[i] = f;
+                    break;
+                }
+                _promote_y(data, series);
+            }
+            series->y.d[i] = y;
+            break;
+        case INTEGER:
+            series->y.i[i] = (int)y;
+            break;
+        case STRING:
+            // the parser passes symbol numbers
+            series->y.str[i] = data->symbols->names[(size_t)y];
+            break;
+    }
+}
+
+// a row is appended if any series keeps it, in the other series it is marked as deleted
+// for a single series the y values and keep flags of the block itself are used, otherwise
+// the filtered values of every series are taken from ycolumns and keepcolumns
+static void _append_block(struct data* data, const struct datablock* block, const double* ycolumns)
+{
+    _reserve_data(data, data->length + block->length);
+    for(size_t j = 0; j < block->length; ++j)
+    {
+        if(!block->keep[j])
+        {
+            continue;
+        }
+        size_t i = data->length;
+        data->x[i] = block->x[j];
+        if(data->numseries == 1)
+        {
+            _store_y(data, data->series, i, block->y[j]);
+        }
+        else
+        {
+            for(size_t s = 0; s < data->numseries; ++s)
+            {
+                _store_y(data, data->series + s, i, ycolumns[s * BLOCK_SIZE + j]);
+            }
+        }
+        ++data->length;
+    }
+}
+
+static void _append_data(struct data* data, struct data* other)
+{
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        if(data->series[s].yfloat != other->series[s].yfloat)
+        {
+            if(data->series[s].yfloat)
+            {
+                _promote_y(data, data->series + s);
+            }
+            else
+            {
+                _promote_y(other, other->series + s);
+            }
+        }
+    }
+    _reserve_data(data, data->length + other->length);
+    // the strings of other belong to its own symbol table, map them to the symbols of data
+    const char** symbolmap = NULL;
+    if(other->symbols && !other->symbols->multibit && (other->length > 0))
+    {
+        if(!data->symbols)
+        {
+            data->symbols = create_symboltable(other->symbols->multibit);
+        }
+        symbolmap = malloc(sizeof(*symbolmap) * other->symbols->numsymbols);
+        for(size_t i = 0; i < other->symbols->numsymbols; ++i)
+        {
+            const char* name = other->symbols->names[i];
+            // interning can move the names array, so it is only read afterwards
+            uint32_t number = intern_symbol(data->symbols, name, strlen(name));
+            symbolmap[i] = data->symbols->names[number];
+        }
+    }
+    memcpy(data->x + data->length, other->x, sizeof(*data->x) * other->length);
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        struct series* series = data->series + s;
+        const struct series* otherseries = other->series + s;
+        size_t ysize = _ysize(series);
+        memcpy((char*)series->y.d + ysize * data->length, otherseries->y.d, ysize * other->length);
+        if(symbolmap)
+        {
+            for(size_t i = 0; i < other->length; ++i)
+            {
+                series->y.str[data->length + i] = symbolmap[_symbol_number(otherseries->y.str[i])];
+            }
+        }
+        for(size_t i = 0; i < other->length; ++i)
+        {
+            if(otherseries->deleted[i / 64] & (1ull << (i % 64)))
+            {
+                size_t j = data->length + i;
+                series->deleted[j / 64] |= 1ull << (j % 64);
+            }
+        }
+    }
+    data->length += other->length;
+    free(symbolmap);
+}
+
+static void _get_datum(const struct data* data, size_t s, size_t i, struct xydatum* datum)
+{
+    const struct series* series = data->series + s;
+    datum->x = data->x[i];
+    datum->y.type = series->ytype;
+    switch(series->ytype)
+    {
+        case REAL:
+            datum->y.d = series->yfloat ? series->y.f[i] : series->y.d[i];
+            break;
+        case INTEGER:
+            datum->y.i = series->y.i[i];
+            break;
+        case STRING:
+            datum->y.str = series->y.str[i];
+            break;
+    }
+}
+
+static int _is_deleted(const struct series* series, size_t i)
+{
+    return (series->deleted[i / 64] >> (i % 64)) & 1;
+}
+
+static void _mark_deleted(struct series* series, size_t i)
+{
+    series->deleted[i / 64] |= 1ull << (i % 64);
+}
+
+// delete a row in all series
+static void _mark_row_deleted(struct data* data, size_t i)
+{
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        _mark_deleted(data->series + s, i);
+    }
+}
+
+// move all rows that are live in at least one series to the front
+// the deletion bitmaps move along, so they stay valid for the remaining rows
+static void _compact_data(struct data* data)
+{
+    size_t length = 0;
+    for(size_t w = 0; w < _bitmap_words(data->length); ++w)
+    {
+        uint64_t deleted = ~0ull;
+        for(size_t s = 0; s < data->numseries; ++s)
+        {
+            deleted &= data->series[s].deleted[w];
+        }
+        size_t base = w * 64;
+        size_t end = base + 64 < data->length ? base + 64 : data->length;
+        if(!deleted && (length == base))
+        {
+            // nothing to move
+            length = end;
+            continue;
+        }
+        for(size_t i = base; i < end; ++i)
+        {
+            if(!((deleted >> (i - base)) & 1))
+            {
+                data->x[length] = data->x[i];
+                for(size_t s = 0; s < data->numseries; ++s)
+                {
+                    struct series* series = data->series + s;
+                    size_t ysize = _ysize(series);
+                    char* y = (char*)series->y.d;
+                    memcpy(y + ysize * length, y + ysize * i, ysize);
+                    uint64_t bit = 1ull << (length % 64);
+                    series->deleted[length / 64] = _is_deleted(series, i) ? series->deleted[length / 64] | bit : series->deleted[length / 64] & ~bit;
+                }
+                ++length;
+            }
+        }
+    }
+    // clear the bits behind the new end
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        uint64_t* bitmap = data->series[s].deleted;
+        size_t words = _bitmap_words(data->length);
+        if(length % 64)
+        {
+            bitmap[length / 64] &= (1ull << (length % 64)) - 1;
+        }
+        size_t first = _bitmap_words(length);
+        if(words > first)
+        {
+            memset(bitmap + first, 0, sizeof(*bitmap) * (words - first));
+        }
+    }
+    data->length = length;
+}
+
+// drop all rows but keep the allocated storage
+static void _clear_data(struct data* data)
+{
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        memset(data->series[s].deleted, 0, sizeof(*data->series[s].deleted) * _bitmap_words(data->length));
+    }
+    data->length = 0;
+}
+
+// with more than one y column the parsed values of all columns are kept next to the block.
+// The filters only keep or drop rows by x and the row index, so the plan runs once with the
+// first series and the further series only get the y transformations
+struct seriesblock {
+    double* y; // BLOCK_SIZE values per series
+};
+
+static struct seriesblock* _create_seriesblock(size_t numseries)
+{
+    if(numseries < 2)
+    {
+        return NULL;
+    }
+    struct seriesblock* seriesblock = malloc(sizeof(*seriesblock));
+    seriesblock->y = malloc(sizeof(*seriesblock->y) * BLOCK_SIZE * numseries);
+    return seriesblock;
+}
+
+static void _destroy_seriesblock(struct seriesblock* seriesblock)
+{
+    if(seriesblock)
+    {
+        free(seriesblock->y);
+        free(seriesblock);
+    }
+}
+
+// apply the plan to a block of rows and append the kept rows to data
+// for a single series the y values are taken from the block itself
+static void _filter_rows(struct datablock* block, struct seriesblock* seriesblock, const struct filterplan* plan, size_t* dropped, struct data* data)
+{
+    if(!seriesblock)
+    {
+        _apply_plan(block, plan, dropped, 1);
+        _append_block(data, block, NULL);
+        return;
+    }
+    size_t length = block->length;
+    memcpy(block->y, seriesblock->y, sizeof(*block->y) * length);
+    _apply_plan(block, plan, dropped, data->numseries);
+    memcpy(seriesblock->y, block->y, sizeof(*block->y) * length);
+    for(size_t s = 1; s < data->numseries; ++s)
+    {
+        double* y = seriesblock->y + s * BLOCK_SIZE;
+        memcpy(block->y, y, sizeof(*block->y) * length);
+        _apply_y_plan(block, plan);
+        memcpy(y, block->y, sizeof(*block->y) * length);
+    }
+    _append_block(data, block, seriesblock->y);
+}
+
+// a range of complete lines that is parsed into its own data segment
+struct parse_job {
+    const char* begin;
+    const char* end;
+    size_t firstrow; // row index of the first line, used by the filters
+    size_t numrows;
+    unsigned int xindex;
+    const unsigned int* yindices;
+    size_t numseries;
+    const char* separator;
+    const struct filterplan* plan;
+    enum ytype ytype;
+    int multibit; // y fields are bus values like 10110
+    int yfloatdecimals;
+    size_t* dropped; // per filter plan stage, only for --stats
+    struct data* data;
+};
+
+// a column that is parsed, x and a y series can share one
+struct field_target {
+    unsigned int index;
+    int isx;
+    double* y; // NULL if the column is only x
+};
+
+// insert into the targets sorted by column
+static void _add_field_target(struct field_target* targets, size_t* numtargets, unsigned int index, double* y)
+{
+    size_t i = *numtargets;
+    if(y)
+    {
+        for(size_t t = 0; t < i; ++t)
+        {
+            if((targets[t].index == index) && !targets[t].y)
+            {
+                targets[t].y = y;
+                return;
+            }
+        }
+    }
+    while((i > 0) && (targets[i - 1].index > index))
+    {
+        targets[i] = targets[i - 1];
+        --i;
+    }
+    targets[i].index = index;
+    targets[i].isx = y == NULL;
+    targets[i].y = y;
+    ++*numtargets;
+}
+
+static void _parse_lines(struct parse_job* job)
+{
+    size_t seplen = strlen(job->separator);
+    const char* pos = job->begin;
+    const char* end = job->end;
+    struct datablock* block = malloc(sizeof(*block));
+    block->length = 0;
+    block->firstrow = job->firstrow;
+    struct seriesblock* seriesblock = _create_seriesblock(job->numseries);
+    // the needed columns in increasing order, the fields behind the last one are not scanned
+    size_t numtargets = 0;
+    struct field_target* targets = malloc(sizeof(*targets) * (job->numseries + 1));
+    _add_field_target(targets, &numtargets, job->xindex, NULL);
+    for(size_t s = 0; s < job->numseries; ++s)
+    {
+        _add_field_target(targets, &numtargets, job->yindices[s], seriesblock ? seriesblock->y + s * BLOCK_SIZE : block->y);
+    }
+    struct symboltable* symbols = NULL;
+    if((job->ytype == STRING) || job->multibit)
+    {
+        if(!job->data->symbols)
+        {
+            job->data->symbols = create_symboltable(job->multibit);
+        }
+        symbols = job->data->symbols;
+    }
+    size_t row = job->firstrow;
+    while(pos < end) /* iterate lines */
+    {
+        const char* lineend = memchr(pos, '\n', end - pos);
+        if(!lineend)
+        {
+            lineend = end;
+        }
+        const char* str = pos;
+        pos = lineend + 1;
+        size_t index = 0;
+        size_t n = block->length;
+        block->x[n] = 0.0;
+        for(size_t t = 0; t < numtargets; ++t)
+        {
+            if(targets[t].y)
+            {
+                targets[t].y[n] = 0.0;
+            }
+        }
+        block->keep[n] = 1;
+        for(size_t t = 0; (t < numtargets) && str; ++t) /* parse line */
+        {
+            const struct field_target* target = targets + t;
+            str = _skip_fields(str, lineend, job->separator, seplen, target->index - index);
+            if(!str)
+            {
+                break;
+            }
+            const char* fieldend;
+            const char* next = _next_separator(str, lineend, job->separator, seplen, &fieldend);
+            if(target->isx)
+            {
+                block->x[n] = _str_to_number(str, fieldend);
+            }
+            if(target->y)
+            {
+                if(symbols)
+                {
+                    uint32_t number = intern_symbol(symbols, str, fieldend - str);
+                    target->y[n] = symbols->values ? (double)symbols->values[number] : (double)number;
+                }
+                else
+                {
+                    target->y[n] = _str_to_number(str, fieldend);
+                }
+            }
+            index = target->index + 1;
+            str = next;
+        }
+        ++block->length;
+        ++row;
+        if(block->length == BLOCK_SIZE)
+        {
+            _filter_rows(block, seriesblock, job->plan, job->dropped, job->data);
+            block->firstrow += block->length;
+            block->length = 0;
+        }
+    }
+    if(block->length > 0)
+    {
+        _filter_rows(block, seriesblock, job->plan, job->dropped, job->data);
+    }
+    free(targets);
+    _destroy_seriesblock(seriesblock);
+    free(block);
+    job->numrows = row - job->firstrow;
+}
+
+static void* _count_lines_worker(void* arg)
+{
+    struct parse_job* job = arg;
+    size_t count = 0;
+    const char* pos = job->begin;
+    while(pos < job->end)
+    {
+        const char* newline = memchr(pos, '\n', job->end - pos);
+        if(!newline)
+        {
+            break;
+        }
+        ++count;
+        pos = newline + 1;
+    }
+    if((job->begin < job->end) && (job->end[-1] != '\n'))
+    {
+        ++count; // last line without newline
+    }
+    job->numrows = count;
+    return NULL;
+}
+
+static void* _parse_lines_worker(void* arg)
+{
+    _parse_lines(arg);
+    return NULL;
+}
+
+static int _run_workers(struct parse_job* jobs, unsigned int numjobs, void* (*worker)(void*))
+{
+    pthread_t* threads = malloc(numjobs * sizeof(*threads));
+    unsigned int started = 0;
+    int ok = 1;
+    for(unsigned int i = 1; i < numjobs; ++i)
+    {
+        if(pthread_create(threads + i, NULL, worker, jobs + i) != 0)
+        {
+            ok = 0;
+            break;
+        }
+        ++started;
+    }
+    if(ok)
+    {
+        worker(jobs + 0);
+    }
+    for(unsigned int i = 1; i <= started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    return ok;
+}
+
+// split the input into newline-aligned chunks and parse them concurrently
+// the chunks are counted first, so that every worker knows the row index of its first line
+// and row-dependent filters (--every-nth) behave exactly like in the serial case
+static struct data* _read_data_parallel(const char* begin, const char* end, unsigned int numthreads, struct parse_job* proto)
+{
+    struct parse_job* jobs = malloc(numthreads * sizeof(*jobs));
+    size_t chunksize = (end - begin) / numthreads;
+    const char* pos = begin;
+    for(unsigned int i = 0; i < numthreads; ++i)
+    {
+        jobs[i] = *proto;
+        jobs[i].begin = pos;
+        if(i == numthreads - 1)
+        {
+            pos = end;
+        }
+        else
+        {
+            const char* split = jobs[i].begin + chunksize;
+            if(split < pos)
+            {
+                split = pos;
+            }
+            const char* newline = split < end ? memchr(split, '\n', end - split) : NULL;
+            pos = newline ? newline + 1 : end;
+        }
+        jobs[i].end = pos;
+        // every worker counts on its own, the counts are summed up at the end
+        jobs[i].dropped = proto->dropped ? calloc(proto->plan->size, sizeof(*proto->dropped)) : NULL;
+    }
+    struct data* data = NULL;
+    if(_run_workers(jobs, numthreads, _count_lines_worker))
+    {
+        // an index can start the range in the middle of the file
+        size_t row = proto->firstrow;
+        for(unsigned int i = 0; i < numthreads; ++i)
+        {
+            jobs[i].firstrow = row;
+            row += jobs[i].numrows;
+            jobs[i].data = _create_data((jobs[i].end - jobs[i].begin) / 16, proto->numseries, proto->ytype, proto->yfloatdecimals);
+        }
+        proto->numrows = row - proto->firstrow;
+        if(_run_workers(jobs, numthreads, _parse_lines_worker))
+        {
+            // stitch segments together in order
+            size_t length = 0;
+            for(unsigned int i = 0; i < numthreads; ++i)
+            {
+                length += jobs[i].data->length;
+            }
+            data = jobs[0].data;
+            _reserve_data(data, length);
+            for(unsigned int i = 1; i < numthreads; ++i)
+            {
+                _append_data(data, jobs[i].data);
+                _destroy_data(jobs[i].data);
+            }
+        }
+        else
+        {
+            for(unsigned int i = 0; i < numthreads; ++i)
+            {
+                _destroy_data(jobs[i].data);
+            }
+        }
+    }
+    if(!data)
+    {
+        fputs("filter_data: could not start worker threads\n", stderr);
+    }
+    for(unsigned int i = 0; i < numthreads; ++i)
+    {
+        if(jobs[i].dropped)
+        {
+            for(size_t k = 0; k < proto->plan->size; ++k)
+            {
+                proto->dropped[k] += jobs[i].dropped[k];
+            }
+            free(jobs[i].dropped);
+        }
+    }
+    free(jobs);
+    return data;
+}
+
+static const char* _after_last_newline(const char* begin, const char* end)
+{
+    const char* pos = end;
+    while(pos > begin)
+    {
+        if(pos[-1] == '\n')
+        {
+            return pos;
+        }
+        --pos;
+    }
+    return NULL;
+}
+
+// parse a source chunk by chunk, every chunk is handed to consume (and then dropped) or,
+// without consume, appended to job->data
+static int _is_binary_data(const char* data, size_t size);
+static int _is_spice_raw(const char* data, size_t size);
+
+// text parsing of a source (file, standard input or decompressed data). Binary and SPICE raw
+// data is only read from mapped files, here it is recognized by its first bytes and rejected
+static int _parse_source(struct source* source, size_t skip, struct parse_job* job, void (*consume)(struct data*, void*), void* arg, struct stats* stats)
+{
+    size_t capacity = STREAM_BUFFER_SIZE;
+    size_t fill = 0;
+    char* buf = malloc(capacity);
+    struct follow* follow = source->follow;
+    size_t row = follow ? follow->row : 0;
+    size_t skipped = follow ? follow->skipped : 0;
+    // a checkpoint resumes in the middle of the file, the start was checked before
+    int detected = follow && (follow->offset > 0);
+    int eof = 0;
+    int ok = 1;
+    while(!eof && !(follow && _follow_stopped))
+    {
+        if(fill == capacity)
+        {
+            // a single line does not fit into the buffer
+            capacity *= 2;
+            buf = realloc(buf, capacity);
+        }
+        ssize_t ret = read_source(source, buf + fill, capacity - fill);
+        if(ret < 0)
+        {
+            // decompression errors are reported by the decompressor
+            if(!source->decompressor)
+            {
+                fprintf(stderr, "filter_data: could not read file '%s'\n", source->filename);
+            }
+            ok = 0;
+            break;
+        }
+        if((ret == 0) && follow)
+        {
+            // caught up with the writer
+            follow->row = row;
+            follow->skipped = skipped;
+            if(follow->checkpoint)
+            {
+                _save_checkpoint(follow->checkpoint, follow);
+            }
+            if(_wait_for_data(source))
+            {
+                continue;
+            }
+            break;
+        }
+        eof = ret == 0;
+        fill += ret;
+        if(stats)
+        {
+            stats->bytesread += ret;
+        }
+        if(!detected)
+        {
+            if((fill < 9) && !eof)
+            {
+                continue;
+            }
+            detected = 1;
+            if(_is_binary_data(buf, fill) || _is_spice_raw(buf, fill))
+            {
+                fprintf(stderr, "filter_data: '%s' holds %s data, it is only read from an uncompressed file without --stream\n", source->filename, _is_spice_raw(buf, fill) ? "SPICE raw" : "binary");
+                ok = 0;
+                break;
+            }
+        }
+        const char* begin = buf;
+        const char* end = buf + fill;
+        // only process complete lines, a trailing partial line is kept for the next read
+        const char* last = eof ? end : _after_last_newline(begin, end);
+        if(!last)
+        {
+            continue;
+        }
+        while((skipped < skip) && (begin < last))
+        {
+            const char* newline = memchr(begin, '\n', last - begin);
+            begin = newline ? newline + 1 : last;
+            ++skipped;
+        }
+        job->begin = begin;
+        job->end = last;
+        job->firstrow = row;
+        if(consume)
+        {
+            _clear_data(job->data);
+        }
+        size_t length = job->data->length;
+        _parse_lines(job);
+        row += job->numrows;
+        if(stats)
+        {
+            stats->rowsparsed += job->numrows;
+            stats->rowskept += job->data->length - length;
+        }
+        if(consume)
+        {
+            consume(job->data, arg);
+        }
+        if(follow)
+        {
+            follow->offset += last - buf;
+        }
+        memmove(buf, last, end - last);
+        fill = end - last;
+    }
+    if(follow && ok)
+    {
+        // stopped while catching up
+        follow->row = row;
+        follow->skipped = skipped;
+        if(follow->checkpoint)
+        {
+            _save_checkpoint(follow->checkpoint, follow);
+        }
+    }
+    free(buf);
+    return ok;
+}
+
+// binary format
+// header (magic, version, number of columns, number of points) followed by one type byte per
+// column, then every column as a contiguous little-endian array. The type bytes and every
+// column are padded to a multiple of eight bytes, so mapped columns are properly aligned
+struct binary_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t numcolumns;
+    uint64_t numpoints;
+};
+
+enum {
+    BINARY_FLOAT64 = 1,
+    BINARY_FLOAT32 = 2,
+    BINARY_INT32 = 3
+};
+
+static const char _binary_magic[8] = { 'F', 'D', 'A', 'T', 'A', 'B', 'I', 'N' };
+
+static size_t _align8(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+static size_t _binary_type_size(uint8_t type)
+{
+    switch(type)
+    {
+        case BINARY_FLOAT64:
+            return 8;
+        case BINARY_FLOAT32:
+        case BINARY_INT32:
+            return 4;
+    }
+    return 0;
+}
+
+static int _is_little_endian(void)
+{
+    const uint16_t value = 1;
+    return *((const uint8_t*)&value) == 1;
+}
+
+static int _is_binary_data(const char* data, size_t size)
+{
+    return (size >= sizeof(_binary_magic)) && (memcmp(data, _binary_magic, sizeof(_binary_magic)) == 0);
+}
+
+static int _is_binary_input(const struct input* input)
+{
+    return _is_binary_data(input->data, input->size);
+}
+
+static double _binary_value(const char* column, uint8_t type, size_t i)
+{
+    switch(type)
+    {
+        case BINARY_FLOAT64:
+            return ((const double*)column)[i];
+        case BINARY_FLOAT32:
+            return ((const float*)column)[i];
+        case BINARY_INT32:
+            return ((const int32_t*)column)[i];
+    }
+    return 0.0;
+}
+
+// without filters the columns are used in place (the mapping is private and writable, so
+// marking and compacting the data only copies the pages that are actually touched)
+static struct data* _read_binary(struct input* input, unsigned int xindex, const unsigned int* yindices, size_t numseries, const struct filterplan* plan, enum ytype ytype, int yfloatdecimals, struct stats* stats)
+{
+    if(!_is_little_endian())
+    {
+        fputs("filter_data: binary input is only supported on little-endian machines\n", stderr);
+        close_input(input);
+        return NULL;
+    }
+    struct binary_header header;
+    if(input->size < sizeof(header))
+    {
+        fputs("filter_data: truncated binary header\n", stderr);
+        close_input(input);
+        return NULL;
+    }
+    memcpy(&header, input->data, sizeof(header));
+    int inrange = xindex < header.numcolumns;
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        inrange = inrange && (yindices[s] < header.numcolumns);
+    }
+    if((header.version != 1) || !inrange)
+    {
+        fprintf(stderr, "filter_data: unsupported binary version or column index out of range (%u columns)\n", header.numcolumns);
+        close_input(input);
+        return NULL;
+    }
+    if(header.numcolumns > input->size - sizeof(header))
+    {
+        fputs("filter_data: truncated binary header\n", stderr);
+        close_input(input);
+        return NULL;
+    }
+    const uint8_t* types = (const uint8_t*)input->data + sizeof(header);
+    size_t offset = _align8(sizeof(header) + header.numcolumns);
+    const char** columns = malloc(sizeof(*columns) * header.numcolumns);
+    for(uint32_t i = 0; i < header.numcolumns; ++i)
+    {
+        // the offset is checked before the subtraction, the column size can't overflow either
+        size_t size = _binary_type_size(types[i]);
+        if((size == 0) || (offset > input->size) || (header.numpoints > (input->size - offset) / size))
+        {
+            fputs("filter_data: invalid or truncated binary data\n", stderr);
+            free(columns);
+            close_input(input);
+            return NULL;
+        }
+        columns[i] = input->data + offset;
+        offset += _align8(size * header.numpoints);
+    }
+    uint8_t xtype = types[xindex];
+    size_t numpoints = header.numpoints;
+    if(stats)
+    {
+        stats->bytesread = input->size;
+        stats->rowsparsed = numpoints;
+        stats->rowskept = numpoints;
+    }
+    int inplace = (plan->size == 0) && (xtype == BINARY_FLOAT64);
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        uint8_t ytypecode = types[yindices[s]];
+        inplace = inplace && (
+            ((ytype == REAL) && (ytypecode == BINARY_FLOAT64) && (yfloatdecimals < 0)) ||
+            ((ytype == REAL) && (ytypecode == BINARY_FLOAT32)) ||
+            (ytypecode == BINARY_INT32)
+        );
+    }
+    struct data* data;
+    if(inplace && input->mapped && (mprotect((void*)input->data, input->size, PROT_READ | PROT_WRITE) == 0))
+    {
+        data = malloc(sizeof(*data));
+        data->x = (double*)columns[xindex];
+        data->numseries = numseries;
+        data->series = malloc(sizeof(*data->series) * numseries);
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            struct series* series = data->series + s;
+            uint8_t ytypecode = types[yindices[s]];
+            series->y.d = (double*)columns[yindices[s]];
+            series->ytype = ytypecode == BINARY_INT32 ? INTEGER : ytype;
+            series->yfloat = ytypecode == BINARY_FLOAT32;
+            series->yfloatscale = 1.0;
+            series->deleted = calloc(_bitmap_words(numpoints > 0 ? numpoints : 1), sizeof(*series->deleted));
+        }
+        data->length = numpoints;
+        data->capacity = numpoints;
+        data->input = input;
+        data->symbols = NULL;
+        free(columns);
+        return data;
+    }
+    data = _create_data(numpoints, numseries, ytype, yfloatdecimals);
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        if(types[yindices[s]] == BINARY_INT32)
+        {
+            // integer columns stay integers
+            struct series* series = data->series + s;
+            free(series->y.d);
+            series->ytype = INTEGER;
+            series->yfloat = 0;
+            series->y.i = malloc(sizeof(*series->y.i) * data->capacity);
+        }
+    }
+    struct datablock* block = malloc(sizeof(*block));
+    struct seriesblock* seriesblock = _create_seriesblock(numseries);
+    block->firstrow = 0;
+    for(size_t start = 0; start < numpoints; start += BLOCK_SIZE)
+    {
+        block->length = numpoints - start < BLOCK_SIZE ? numpoints - start : BLOCK_SIZE;
+        for(size_t i = 0; i < block->length; ++i)
+        {
+            block->x[i] = _binary_value(columns[xindex], xtype, start + i);
+            block->keep[i] = 1;
+        }
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            double* y = seriesblock ? seriesblock->y + s * BLOCK_SIZE : block->y;
+            for(size_t i = 0; i < block->length; ++i)
+            {
+                y[i] = _binary_value(columns[yindices[s]], types[yindices[s]], start + i);
+            }
+        }
+        _filter_rows(block, seriesblock, plan, stats ? stats->dropped : NULL, data);
+        block->firstrow += block->length;
+    }
+    _destroy_seriesblock(seriesblock);
+    free(block);
+    free(columns);
+    close_input(input);
+    if(stats)
+    {
+        stats->rowskept = data->length;
+    }
+    return data;
+}
+
+// SPICE raw files (nutmeg format, written by ngspice, Spectre and others): a text header
+// with the variable names, followed by the values of all points, either as doubles
+// ("Binary:") or as text ("Values:"). The variables are the columns (xindex 0 is usually time):
+//
+//     Title: ...
+//     Plotname: Transient Analysis
+//     Flags: real
+//     No. Variables: 3
+//     No. Points: 1000
+//     Variables:
+//             0       time    time
+//             1       v(out)  voltage
+//             2       i(v1)   current
+//     Binary:
+//
+// complex files (ac analysis) hold two doubles per variable, only the first plot is read
+enum complex_part {
+    COMPLEX_MAGNITUDE,
+    COMPLEX_DB,
+    COMPLEX_PHASE,
+    COMPLEX_REAL,
+    COMPLEX_IMAG
+};
+
+struct spice_header {
+    size_t numvariables;
+    size_t numpoints;
+    int complex;
+    int binary;
+    char** names;
+    const char* values; // first byte after the "Binary:" or "Values:" line
+};
+
+static int _is_spice_raw(const char* data, size_t size)
+{
+    return ((size >= 6) && (strncmp(data, "Title:", 6) == 0)) || ((size >= 9) && (strncmp(data, "Plotname:", 9) == 0));
+}
+
+static int _is_whitespace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+// returns the rest of the line after the key or NULL, keys are matched case-insensitively
+static const char* _spice_key(const char* line, const char* lineend, const char* key)
+{
+    size_t length = strlen(key);
+    if(((size_t)(lineend - line) < length) || (strncasecmp(line, key, length) != 0))
+    {
+        return NULL;
+    }
+    return line + length;
+}
+
+static void _destroy_spice_header(struct spice_header* header)
+{
+    if(header->names)
+    {
+        for(size_t i = 0; i < header->numvariables; ++i)
+        {
+            free(header->names[i]);
+        }
+        free(header->names);
+    }
+}
+
+// variable entries: index, name and type separated by whitespace
+static int _parse_spice_variable(struct spice_header* header, size_t i, const char* pos, const char* lineend)
+{
+    while((pos < lineend) && _is_whitespace(*pos))
+    {
+        ++pos;
+    }
+    while((pos < lineend) && !_is_whitespace(*pos))
+    {
+        ++pos;
+    }
+    while((pos < lineend) && _is_whitespace(*pos))
+    {
+        ++pos;
+    }
+    const char* name = pos;
+    while((pos < lineend) && !_is_whitespace(*pos))
+    {
+        ++pos;
+    }
+    if(pos == name)
+    {
+        return 0;
+    }
+    header->names[i] = strndup(name, pos - name);
+    return 1;
+}
+
+static int _parse_spice_header(const struct input* input, struct spice_header* header)
+{
+    memset(header, 0, sizeof(*header));
+    const char* pos = input->data;
+    const char* end = input->data + input->size;
+    size_t numnames = 0;
+    int invariables = 0;
+    while(pos < end)
+    {
+        const char* newline = memchr(pos, '\n', end - pos);
+        const char* lineend = newline ? newline : end;
+        const char* next = newline ? newline + 1 : end;
+        const char* rest;
+        if(invariables && (numnames < header->numvariables))
+        {
+            if(!_parse_spice_variable(header, numnames, pos, lineend))
+            {
+                break;
+            }
+            ++numnames;
+        }
+        else if((rest = _spice_key(pos, lineend, "No. Variables:")))
+        {
+            header->numvariables = strtoul(rest, NULL, 10);
+        }
+        else if((rest = _spice_key(pos, lineend, "No. Points:")))
+        {
+            header->numpoints = strtoull(rest, NULL, 10);
+        }
+        else if((rest = _spice_key(pos, lineend, "Flags:")))
+        {
+            // e.g. "real", "complex", "real padded"
+            const char* flag = rest;
+            while((flag < lineend) && _is_whitespace(*flag))
+            {
+                ++flag;
+            }
+            header->complex = (lineend - flag >= 7) && (strncasecmp(flag, "complex", 7) == 0);
+        }
+        else if((rest = _spice_key(pos, lineend, "Variables:")))
+        {
+            if((header->numvariables == 0) || header->names)
+            {
+                break;
+            }
+            header->names = calloc(header->numvariables, sizeof(*header->names));
+            invariables = 1;
+            // some writers put the first variable on the same line
+            const char* entry = rest;
+            while((entry < lineend) && _is_whitespace(*entry))
+            {
+                ++entry;
+            }
+            if(entry < lineend)
+            {
+                if(!_parse_spice_variable(header, 0, rest, lineend))
+                {
+                    break;
+                }
+                numnames = 1;
+            }
+        }
+        else if(_spice_key(pos, lineend, "Binary:") || _spice_key(pos, lineend, "Values:"))
+        {
+            header->binary = _spice_key(pos, lineend, "Binary:") != NULL;
+            header->values = next;
+            break;
+        }
+        pos = next;
+    }
+    if(!header->values || !header->names || (numnames < header->numvariables))
+    {
+        fputs("filter_data: invalid SPICE raw header (variables or values are missing)\n", stderr);
+        _destroy_spice_header(header);
+        return 0;
+    }
+    return 1;
+}
+
+// point holds one double per variable, two (real and imaginary part) for complex data
+static double _spice_value(const char* point, unsigned int variable, int complex, enum complex_part part)
+{
+    double value[2];
+    if(!complex)
+    {
+        memcpy(value, point + sizeof(double) * variable, sizeof(double));
+        return value[0];
+    }
+    memcpy(value, point + 2 * sizeof(double) * variable, sizeof(value));
+    switch(part)
+    {
+        case COMPLEX_MAGNITUDE:
+            return hypot(value[0], value[1]);
+        case COMPLEX_DB:
+            return 20.0 * log10(hypot(value[0], value[1]));
+        case COMPLEX_PHASE:
+            return atan2(value[1], value[0]) * 180.0 / M_PI;
+        case COMPLEX_REAL:
+            return value[0];
+        case COMPLEX_IMAG:
+            return value[1];
+    }
+    return 0.0;
+}
+
+static const char* _next_token(const char* pos, const char* end, const char** tokenend)
+{
+    while((pos < end) && _is_whitespace(*pos))
+    {
+        ++pos;
+    }
+    const char* token = pos;
+    while((pos < end) && !_is_whitespace(*pos))
+    {
+        ++pos;
+    }
+    *tokenend = pos;
+    return token;
+}
+
+// text values: the point index followed by the values of all variables (complex as re,im)
+static int _parse_spice_point(const char** pos, const char* end, double* values, size_t numvariables, int complex)
+{
+    const char* tokenend;
+    const char* token = _next_token(*pos, end, &tokenend);
+    if((token == tokenend) || !_is_digit(*token))
+    {
+        return 0;
+    }
+    for(size_t i = 0; i < numvariables; ++i)
+    {
+        token = _next_token(tokenend, end, &tokenend);
+        if(token == tokenend)
+        {
+            return 0;
+        }
+        if(complex)
+        {
+            const char* comma = memchr(token, ',', tokenend - token);
+            if(!comma)
+            {
+                return 0;
+            }
+            values[2 * i] = _str_to_number(token, comma);
+            values[2 * i + 1] = _str_to_number(comma + 1, tokenend);
+        }
+        else
+        {
+            values[i] = _str_to_number(token, tokenend);
+        }
+    }
+    *pos = tokenend;
+    return 1;
+}
+
+// binary values are picked directly from the file, only the selected variables are touched
+static struct data* _read_spice(struct input* input, unsigned int xindex, const unsigned int* yindices, size_t numseries, const struct filterplan* plan, enum ytype ytype, int yfloatdecimals, enum complex_part complexpart, struct stats* stats)
+{
+    struct spice_header header;
+    if(!_parse_spice_header(input, &header))
+    {
+        close_input(input);
+        return NULL;
+    }
+    int inrange = xindex < header.numvariables;
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        inrange = inrange && (yindices[s] < header.numvariables);
+    }
+    if(!inrange)
+    {
+        fprintf(stderr, "filter_data: column index out of range (%zu variables)\n", header.numvariables);
+        _destroy_spice_header(&header);
+        close_input(input);
+        return NULL;
+    }
+    if(header.binary && !_is_little_endian())
+    {
+        fputs("filter_data: binary SPICE raw files are only supported on little-endian machines\n", stderr);
+        _destroy_spice_header(&header);
+        close_input(input);
+        return NULL;
+    }
+    const char* end = input->data + input->size;
+    size_t pointsize = sizeof(double) * header.numvariables * (header.complex ? 2 : 1);
+    size_t numpoints = header.numpoints;
+    if(header.binary)
+    {
+        // a simulation that was aborted leaves fewer points than announced
+        size_t available = (end - header.values) / pointsize;
+        if((numpoints == 0) || (numpoints > available))
+        {
+            if(numpoints > 0)
+            {
+                fprintf(stderr, "filter_data: truncated SPICE raw file, reading %zu of %zu points\n", available, numpoints);
+            }
+            numpoints = available;
+        }
+    }
+    double* values = header.binary ? NULL : malloc(pointsize);
+    struct data* data = _create_data(numpoints > 0 ? numpoints : 1024, numseries, ytype, yfloatdecimals);
+    struct datablock* block = malloc(sizeof(*block));
+    struct seriesblock* seriesblock = _create_seriesblock(numseries);
+    block->firstrow = 0;
+    block->length = 0;
+    const char* pos = header.values;
+    size_t row = 0;
+    while(1)
+    {
+        const char* point;
+        if(header.binary)
+        {
+            if(row == numpoints)
+            {
+                break;
+            }
+            point = header.values + row * pointsize;
+        }
+        else
+        {
+            // stops at the end of the values or at the next plot
+            if(((header.numpoints > 0) && (row == header.numpoints)) || !_parse_spice_point(&pos, end, values, header.numvariables, header.complex))
+            {
+                break;
+            }
+            point = (const char*)values;
+        }
+        size_t i = block->length;
+        // the x axis of an ac analysis (frequency) is complex with a zero imaginary part
+        block->x[i] = _spice_value(point, xindex, header.complex, COMPLEX_REAL);
+        block->keep[i] = 1;
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            double* y = seriesblock ? seriesblock->y + s * BLOCK_SIZE : block->y;
+            y[i] = _spice_value(point, yindices[s], header.complex, complexpart);
+        }
+        ++block->length;
+        ++row;
+        if(block->length == BLOCK_SIZE)
+        {
+            _filter_rows(block, seriesblock, plan, stats ? stats->dropped : NULL, data);
+            block->firstrow += block->length;
+            block->length = 0;
+        }
+    }
+    if(block->length > 0)
+    {
+        _filter_rows(block, seriesblock, plan, stats ? stats->dropped : NULL, data);
+    }
+    if(stats)
+    {
+        stats->bytesread = input->size;
+        stats->rowsparsed = row;
+        stats->rowskept = data->length;
+    }
+    _destroy_seriesblock(seriesblock);
+    free(block);
+    free(values);
+    _destroy_spice_header(&header);
+    close_input(input);
+    return data;
+}
+
+static unsigned int _find_spice_variable(const struct spice_header* header, const char* name, size_t length)
+{
+    for(size_t i = 0; i < header->numvariables; ++i)
+    {
+        if((strlen(header->names[i]) == length) && (strncasecmp(header->names[i], name, length) == 0))
+        {
+            return i;
+        }
+    }
+    return UINT_MAX;
+}
+
+// sparse index
+// for files with monotone x, an index sidecar (<filename>.fdidx) stores the x value, byte offset
+// and row number of every nth data row. A range check on the untransformed x then only needs to
+// parse the rows between the two index entries enclosing the range. The index is only used if
+// file size, modification time and the parse settings (skip, xindex, separator) still match
+struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t xindex;
+    uint64_t stride;
+    uint64_t filesize;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t skip;
+    uint64_t numentries;
+    char separator[INDEX_SEPARATOR_SIZE];
+};
+
+struct index_entry {
+    double x;
+    uint64_t offset;
+    uint64_t row;
+};
+
+static const char _index_magic[8] = { 'F', 'D', 'I', 'N', 'D', 'E', 'X', '1' };
+
+static char* _index_filename(const char* filename)
+{
+    size_t length = strlen(filename);
+    char* indexname = malloc(length + sizeof(INDEX_SUFFIX));
+    memcpy(indexname, filename, length);
+    memcpy(indexname + length, INDEX_SUFFIX, sizeof(INDEX_SUFFIX));
+    return indexname;
+}
+
+static void _fill_index_header(struct index_header* header, const struct stat* st, size_t skip, unsigned int xindex, const char* separator)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, _index_magic, sizeof(header->magic));
+    header->version = 1;
+    header->xindex = xindex;
+    header->filesize = st->st_size;
+    header->mtime_sec = st->st_mtim.tv_sec;
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+    header->skip = skip;
+    strncpy(header->separator, separator, sizeof(header->separator) - 1);
+}
+
+// value of field xindex of the line [str, lineend)
+static double _parse_field(const char* str, const char* lineend, unsigned int xindex, const char* separator, size_t seplen)
+{
+    str = _skip_fields(str, lineend, separator, seplen, xindex);
+    if(!str)
+    {
+        return 0.0;
+    }
+    const char* fieldend;
+    _next_separator(str, lineend, separator, seplen, &fieldend);
+    return _str_to_number(str, fieldend);
+}
+
+static int build_index(const char* filename, const struct input* input, const char* begin, size_t skip, unsigned int xindex, const char* separator, size_t stride)
+{
+    struct stat st;
+    if(!input->mapped || (stat(filename, &st) != 0) || (strlen(separator) >= INDEX_SEPARATOR_SIZE))
+    {
+        fprintf(stderr, "filter_data: can't build an index for '%s'\n", filename);
+        return 0;
+    }
+    size_t seplen = strlen(separator);
+    size_t capacity = 1024;
+    size_t numentries = 0;
+    struct index_entry* entries = malloc(capacity * sizeof(*entries));
+    const char* pos = begin;
+    const char* end = input->data + input->size;
+    size_t row = 0;
+    double lastx = -INFINITY;
+    while(pos < end)
+    {
+        const char* lineend = memchr(pos, '\n', end - pos);
+        if(!lineend)
+        {
+            lineend = end;
+        }
+        double x = _parse_field(pos, lineend, xindex, separator, seplen);
+        if(!(x >= lastx))
+        {
+            fprintf(stderr, "filter_data: x is not monotone in row %zu, no index written\n", row);
+            free(entries);
+            return 0;
+        }
+        lastx = x;
+        if(row % stride == 0)
+        {
+            if(numentries == capacity)
+            {
+                capacity *= 2;
+                entries = realloc(entries, capacity * sizeof(*entries));
+            }
+            entries[numentries].x = x;
+            entries[numentries].offset = pos - input->data;
+            entries[numentries].row = row;
+            ++numentries;
+        }
+        pos = lineend + 1;
+        ++row;
+    }
+    struct index_header header;
+    _fill_index_header(&header, &st, skip, xindex, separator);
+    header.stride = stride;
+    header.numentries = numentries;
+    char* indexname = _index_filename(filename);
+    size_t length = strlen(indexname);
+    char* tmpname = malloc(length + 5);
+    memcpy(tmpname, indexname, length);
+    memcpy(tmpname + length, ".tmp", 5);
+    FILE* file = fopen(tmpname, "wb");
+    int ok = file &&
+        (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(entries, sizeof(*entries), numentries, file) == numentries);
+    if(file && (fclose(file) != 0))
+    {
+        ok = 0;
+    }
+    ok = ok && (rename(tmpname, indexname) == 0);
+    if(!ok)
+    {
+        fprintf(stderr, "filter_data: could not write index '%s'\n", indexname);
+        remove(tmpname);
+    }
+    free(tmpname);
+    free(indexname);
+    free(entries);
+    return ok;
+}
+
+// returns the entries of a valid index for this file and these settings or NULL
+static struct index_entry* _load_index(const char* filename, size_t skip, unsigned int xindex, const char* separator, size_t* numentries)
+{
+    struct stat st;
+    if(stat(filename, &st) != 0)
+    {
+        return NULL;
+    }
+    char* indexname = _index_filename(filename);
+    FILE* file = fopen(indexname, "rb");
+    free(indexname);
+    if(!file)
+    {
+        return NULL;
+    }
+    struct index_header expected;
+    _fill_index_header(&expected, &st, skip, xindex, separator);
+    struct index_header header;
+    struct index_entry* entries = NULL;
+    if((strlen(separator) < INDEX_SEPARATOR_SIZE) &&
+       (fread(&header, sizeof(header), 1, file) == 1) &&
+       (memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0) &&
+       (header.version == expected.version) &&
+       (header.xindex == expected.xindex) &&
+       (header.filesize == expected.filesize) &&
+       (header.mtime_sec == expected.mtime_sec) &&
+       (header.mtime_nsec == expected.mtime_nsec) &&
+       (header.skip == expected.skip) &&
+       (memcmp(header.separator, expected.separator, sizeof(header.separator)) == 0) &&
+       (header.numentries > 0) && (header.numentries < SIZE_MAX / sizeof(*entries)))
+    {
+        entries = malloc(header.numentries * sizeof(*entries));
+        if(fread(entries, sizeof(*entries), header.numentries, file) != header.numentries)
+        {
+            free(entries);
+            entries = NULL;
+        }
+        *numentries = header.numentries;
+    }
+    fclose(file);
+    return entries;
+}
+
+// narrow [*begin, *end) down to the rows that can pass the range checks of the plan
+static void _seek_index(const char* filename, const struct input* input, size_t skip, unsigned int xindex, const char* separator, const struct filterplan* plan, const char** begin, const char** end, size_t* firstrow)
+{
+    double xmin, xmax;
+    if(!input->mapped || !_raw_x_range(plan, &xmin, &xmax))
+    {
+        return;
+    }
+    size_t numentries;
+    struct index_entry* entries = _load_index(filename, skip, xindex, separator, &numentries);
+    if(!entries)
+    {
+        return;
+    }
+    // last entry with x < xmin: all rows before it are smaller as well
+    size_t lo = 0;
+    size_t hi = numentries;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(entries[mid].x < xmin)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    size_t first = lo > 0 ? lo - 1 : 0;
+    // first entry with x > xmax: this and all following rows are larger as well
+    lo = first;
+    hi = numentries;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(entries[mid].x > xmax)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    if((entries[first].offset <= input->size) && (entries[first].row > 0 || first == 0))
+    {
+        *begin = input->data + entries[first].offset;
+        *firstrow = entries[first].row;
+    }
+    if((lo < numentries) && (entries[lo].offset <= input->size))
+    {
+        *end = input->data + entries[lo].offset;
+    }
+    free(entries);
+}
+
+// stats is NULL unless --stats is given
+static struct data* read_data(const char* filename, size_t skip, unsigned int xindex, const unsigned int* yindices, size_t numseries, const char* separator, const struct filterplan* plan, enum ytype ytype, int multibit, int yfloatdecimals, unsigned int numthreads, size_t indexstride, enum complex_part complexpart, struct stats* stats)
+{
+    struct input* input = open_input(filename);
+    if(!input)
+    {
+        return NULL;
+    }
+    if(_is_compressed(input))
+    {
+        // inflated while parsing
+        close_input(input);
+        struct source* source = open_source(filename);
+        if(!source)
+        {
+            return NULL;
+        }
+        struct parse_job job = {
+            .xindex = xindex,
+            .yindices = yindices,
+            .numseries = numseries,
+            .separator = separator,
+            .plan = plan,
+            .ytype = ytype,
+            .multibit = multibit,
+            .yfloatdecimals = yfloatdecimals,
+            .dropped = stats ? stats->dropped : NULL,
+            .data = _create_data(1024, numseries, ytype, yfloatdecimals),
+        };
+        int ok = _parse_source(source, skip, &job, NULL, NULL, stats);
+        if(!close_source(source) || !ok)
+        {
+            _destroy_data(job.data);
+            return NULL;
+        }
+        return job.data;
+    }
+    if(_is_binary_input(input))
+    {
+        if((ytype == STRING) || multibit)
+        {
+            fputs("filter_data: binary input holds no string data\n", stderr);
+            close_input(input);
+            return NULL;
+        }
+        return _read_binary(input, xindex, yindices, numseries, plan, ytype, yfloatdecimals, stats);
+    }
+    if(_is_spice_raw(input->data, input->size))
+    {
+        if((ytype == STRING) || multibit)
+        {
+            fputs("filter_data: SPICE raw files hold no string data\n", stderr);
+            close_input(input);
+            return NULL;
+        }
+        return _read_spice(input, xindex, yindices, numseries, plan, ytype, yfloatdecimals, complexpart, stats);
+    }
+    const char* pos = input->data;
+    const char* end = input->data + input->size;
+    // skip header lines
+    for(size_t i = 0; (i < skip) && (pos < end); ++i)
+    {
+        const char* newline = memchr(pos, '\n', end - pos);
+        pos = newline ? newline + 1 : end;
+    }
+    if(indexstride > 0)
+    {
+        build_index(filename, input, pos, skip, xindex, separator, indexstride);
+    }
+    size_t firstrow = 0;
+    _seek_index(filename, input, skip, xindex, separator, plan, &pos, &end, &firstrow);
+    struct parse_job job = {
+        .begin = pos,
+        .end = end,
+        .firstrow = firstrow,
+        .xindex = xindex,
+        .yindices = yindices,
+        .numseries = numseries,
+        .separator = separator,
+        .plan = plan,
+        .ytype = ytype,
+        .multibit = multibit,
+        .yfloatdecimals = yfloatdecimals,
+        .dropped = stats ? stats->dropped : NULL,
+    };
+    struct data* data;
+    // small inputs are not worth the thread overhead
+    if((numthreads > 1) && ((size_t)(end - pos) >= numthreads * MIN_CHUNK_SIZE))
+    {
+        data = _read_data_parallel(pos, end, numthreads, &job);
+    }
+    else
+    {
+        data = _create_data(1024, numseries, ytype, yfloatdecimals);
+        job.data = data;
+        _parse_lines(&job);
+    }
+    if(stats && data)
+    {
+        stats->bytesread = end - pos;
+        stats->rowsparsed = job.numrows;
+        stats->rowskept = data->length;
+    }
+    close_input(input);
+    return data;
+}
+
+static void _scale_x(struct datablock* block, void* factor)
+{
+    double f = *((double*)factor);
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->x[i] *= f;
+    }
+}
+
+static void _scale_y(struct datablock* block, void* factor)
+{
+    double f = *((double*)factor);
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->y[i] *= f;
+    }
+}
+
+static void _x_min(struct datablock* block, void* min)
+{
+    double m = *((double*)min);
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->keep[i] = (block->x[i] < m) ? 0 : block->keep[i];
+    }
+}
+
+static void _x_max(struct datablock* block, void* max)
+{
+    double m = *((double*)max);
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->keep[i] = (block->x[i] > m) ? 0 : block->keep[i];
+    }
+}
+
+static void _shift_x(struct datablock* block, void* shift)
+{
+    double s = *((double*)shift);
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->x[i] += s;
+    }
+}
+
+static void _shift_y(struct datablock* block, void* shift)
+{
+    double s = *((double*)shift);
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->y[i] += s;
+    }
+}
+
+static void _y_is_integer(struct datablock* block)
+{
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->y[i] = (int)block->y[i];
+    }
+}
+
+static void _every_nth(struct datablock* block, void* nthp)
+{
+    size_t nth = *((int*)nthp);
+    // index of the first row in this block that is kept
+    size_t first = (nth - block->firstrow % nth) % nth;
+    for(size_t i = 0; i < block->length; ++i)
+    {
+        block->keep[i] &= (i % nth) == first;
+    }
+}
+
+static struct filter* _create_filter_0_arg(filter_func_0_arg func)
+{
+    struct filter* filter = malloc(sizeof(*filter));
+    filter->func_0_arg = func;
+    filter->type = FILTER_0_ARG;
+    return filter;
+}
+
+static struct filter* _create_filter_1_arg(filter_func_1_arg func, void* arg)
+{
+    struct filter* filter = malloc(sizeof(*filter));
+    filter->func_1_arg = func;
+    filter->type = FILTER_1_ARG;
+    filter->arg1 = arg;
+    return filter;
+}
+
+static struct filter* _create_filter_2_arg(filter_func_2_arg func, void* arg1, void* arg2)
+{
+    struct filter* filter = malloc(sizeof(*filter));
+    filter->func_2_arg = func;
+    filter->type = FILTER_2_ARG;
+    filter->arg1 = arg1;
+    filter->arg2 = arg2;
+    return filter;
+}
+
+static void _append_filter(struct filterlist* filterlist, struct filter* filter)
+{
+    filterlist->filter = realloc(filterlist->filter, (filterlist->size + 1) * sizeof(*filterlist->filter));
+    filterlist->filter[filterlist->size] = filter;
+    ++filterlist->size;
+}
+
+// command line option of a filter, used to label the stages of a plan
+static const char* _filter_option(const struct filter* filter)
+{
+    if(filter->type == FILTER_0_ARG)
+    {
+        return filter->func_0_arg == _y_is_integer ? "--y-is-integer" : "filter";
+    }
+    filter_func_1_arg func = filter->type == FILTER_1_ARG ? filter->func_1_arg : NULL;
+    if(func == _scale_x)
+    {
+        return "--xscale";
+    }
+    if(func == _scale_y)
+    {
+        return "--yscale";
+    }
+    if(func == _shift_x)
+    {
+        return "--xshift";
+    }
+    if(func == _shift_y)
+    {
+        return "--yshift";
+    }
+    if(func == _x_min)
+    {
+        return "--xmin";
+    }
+    if(func == _x_max)
+    {
+        return "--xmax";
+    }
+    if(func == _every_nth)
+    {
+        return "--every-nth";
+    }
+    return "filter";
+}
+
+static void _add_label(struct filterstage* stage, const char* option)
+{
+    size_t length = strlen(stage->label);
+    if(length > 0)
+    {
+        snprintf(stage->label + length, FILTER_LABEL_SIZE - length, " %s", option);
+    }
+    else
+    {
+        snprintf(stage->label, FILTER_LABEL_SIZE, "%s", option);
+    }
+}
+
+static struct fused_stage* _open_fused_stage(struct filterplan* plan)
+{
+    plan->stages = realloc(plan->stages, (plan->size + 1) * sizeof(*plan->stages));
+    struct filterstage* stage = plan->stages + plan->size;
+    ++plan->size;
+    stage->type = STAGE_FUSED;
+    stage->filter = NULL;
+    stage->yonly = 0;
+    stage->label[0] = 0;
+    stage->fused.prexmin = -INFINITY;
+    stage->fused.prexmax = INFINITY;
+    // x * 1.0 and x + -0.0 give x for every x (also -0.0), a stage without a scale or a shift
+    // computes the same as the filters on their own
+    stage->fused.xscale = 1.0;
+    stage->fused.xshift = -0.0;
+    stage->fused.yscale = 1.0;
+    stage->fused.yshift = -0.0;
+    stage->fused.postxmin = -INFINITY;
+    stage->fused.postxmax = INFINITY;
+    stage->fused.shape = 0;
+    return &stage->fused;
+}
+
+static void _append_filter_stage(struct filterplan* plan, struct filter* filter)
+{
+    plan->stages = realloc(plan->stages, (plan->size + 1) * sizeof(*plan->stages));
+    plan->stages[plan->size].type = STAGE_FILTER;
+    plan->stages[plan->size].filter = filter;
+    filter_func_1_arg func = filter->type == FILTER_1_ARG ? filter->func_1_arg : NULL;
+    plan->stages[plan->size].yonly = ((filter->type == FILTER_0_ARG) && (filter->func_0_arg == _y_is_integer)) || (func == _scale_y) || (func == _shift_y);
+    plan->stages[plan->size].label[0] = 0;
+    _add_label(plan->stages + plan->size, _filter_option(filter));
+    ++plan->size;
+}
+
+static int _is_power_of_two(double value)
+{
+    int exponent;
+    return isfinite(value) && (fabs(frexp(value, &exponent)) == 0.5);
+}
+
+// build the execution plan for a filter list
+// scale and shift filters are folded into one affine transformation x * scale + shift per axis,
+// range checks are moved in front of all y transformations (they only depend on x) and merged
+// with each other. Range checks that follow an x transformation are evaluated on the transformed
+// value in the same pass. --every-nth only depends on the row index, so it does not interrupt a
+// fused stage. Only exact compositions are folded, the values are the same as with the filters
+// applied one after another: per axis one shift after the scales, and several scales only if
+// all but one are powers of two (scaling by them does not round). Anything else starts a new
+// stage. With fuse == 0 every filter gets its own stage
+static struct filterplan* plan_filters(const struct filterlist* filterlist, int fuse)
+{
+    struct filterplan* plan = malloc(sizeof(*plan));
+    plan->stages = NULL;
+    plan->size = 0;
+    long current = -1; // index of the open fused stage
+    // transformations folded into the open stage
+    int xscaled = 0;
+    int xshifted = 0;
+    int yscaled = 0;
+    int yshifted = 0;
+    for(size_t i = 0; i < filterlist->size; ++i)
+    {
+        struct filter* filter = filterlist->filter[i];
+        filter_func_1_arg func = filter->type == FILTER_1_ARG ? filter->func_1_arg : NULL;
+        int fusable = fuse && (
+            (func == _scale_x) || (func == _shift_x) ||
+            (func == _scale_y) || (func == _shift_y) ||
+            (func == _x_min) || (func == _x_max)
+        );
+        if(!fusable)
+        {
+            if(!(fuse && (func == _every_nth)))
+            {
+                current = -1;
+            }
+            _append_filter_stage(plan, filter);
+            continue;
+        }
+        double arg = *((double*)filter->arg1);
+        struct fused_stage* stage = current >= 0 ? &plan->stages[current].fused : NULL;
+        int exact = 1;
+        if(stage && (func == _scale_x))
+        {
+            // a range check on transformed values also needs the transformation to end there
+            exact = !(stage->shape & SHAPE_POST_RANGE) && !xshifted && (!xscaled || _is_power_of_two(arg) || _is_power_of_two(stage->xscale));
+        }
+        else if(stage && (func == _shift_x))
+        {
+            exact = !(stage->shape & SHAPE_POST_RANGE) && !xshifted;
+        }
+        else if(stage && (func == _scale_y))
+        {
+            exact = !yshifted && (!yscaled || _is_power_of_two(arg) || _is_power_of_two(stage->yscale));
+        }
+        else if(stage && (func == _shift_y))
+        {
+            exact = !yshifted;
+        }
+        if(!stage || !exact)
+        {
+            stage = _open_fused_stage(plan);
+            current = plan->size - 1;
+            xscaled = 0;
+            xshifted = 0;
+            yscaled = 0;
+            yshifted = 0;
+        }
+        _add_label(plan->stages + current, _filter_option(filter));
+        if(func == _scale_x)
+        {
+            stage->xscale *= arg;
+            stage->shape |= SHAPE_X_AFFINE;
+            xscaled = 1;
+        }
+        else if(func == _shift_x)
+        {
+            stage->xshift += arg;
+            stage->shape |= SHAPE_X_AFFINE;
+            xshifted = 1;
+        }
+        else if(func == _scale_y)
+        {
+            stage->yscale *= arg;
+            stage->shape |= SHAPE_Y_AFFINE;
+            yscaled = 1;
+        }
+        else if(func == _shift_y)
+        {
+            stage->yshift += arg;
+            stage->shape |= SHAPE_Y_AFFINE;
+            yshifted = 1;
+        }
+        else if(stage->shape & SHAPE_X_AFFINE)
+        {
+            if(func == _x_min)
+            {
+                stage->postxmin = fmax(stage->postxmin, arg);
+            }
+            else
+            {
+                stage->postxmax = fmin(stage->postxmax, arg);
+            }
+            stage->shape |= SHAPE_POST_RANGE;
+        }
+        else
+        {
+            if(func == _x_min)
+            {
+                stage->prexmin = fmax(stage->prexmin, arg);
+            }
+            else
+            {
+                stage->prexmax = fmin(stage->prexmax, arg);
+            }
+            stage->shape |= SHAPE_PRE_RANGE;
+        }
+    }
+    return plan;
+}
+
+static void destroy_filterplan(struct filterplan* plan)
+{
+    free(plan->stages);
+    free(plan);
+}
+
+// range of untransformed x values that the filter plan keeps at most
+// only range checks in front of the first x transformation count
+static int _raw_x_range(const struct filterplan* plan, double* xmin, double* xmax)
+{
+    *xmin = -INFINITY;
+    *xmax = INFINITY;
+    for(size_t i = 0; i < plan->size; ++i)
+    {
+        const struct filterstage* stage = plan->stages + i;
+        if(stage->type == STAGE_FUSED)
+        {
+            if(stage->fused.shape & SHAPE_PRE_RANGE)
+            {
+                *xmin = fmax(*xmin, stage->fused.prexmin);
+                *xmax = fmin(*xmax, stage->fused.prexmax);
+            }
+            if(stage->fused.shape & SHAPE_X_AFFINE)
+            {
+                break;
+            }
+        }
+        else
+        {
+            const struct filter* filter = stage->filter;
+            filter_func_1_arg func = filter->type == FILTER_1_ARG ? filter->func_1_arg : NULL;
+            if(func == _x_min)
+            {
+                *xmin = fmax(*xmin, *((double*)filter->arg1));
+            }
+            else if(func == _x_max)
+            {
+                *xmax = fmin(*xmax, *((double*)filter->arg1));
+            }
+            else if(!((filter->type == FILTER_0_ARG) || (func == _every_nth) || (func == _scale_y) || (func == _shift_y)))
+            {
+                break;
+            }
+        }
+    }
+    return (*xmin > -INFINITY) || (*xmax < INFINITY);
+}
+
+static void _usage(void)
+{
+    puts("Filter simulation data");
+    puts("    <filename> (string)                  filename of data, - reads from standard input (implies --stream). SPICE raw files\n"
+         "                                         (binary or ascii, e.g. from ngspice) are recognized, their variables are the columns");
+    puts("    --batch <manifest>                   instead of <filename>: process all input/output pairs listed in the manifest (one pair per\n"
+         "                                         line) with the same options, streamed concurrently by -j workers (default: all cores)");
+    puts("    <xindex> (number)                    index of x data (for SPICE raw files also the variable name, e.g. time)");
+    puts("    <yindex> (list)                      index if y data, a comma separated list of indices and ranges (e.g. 1,3-5) extracts\n"
+         "                                         several series in one pass, printed as wide rows (x y1 y2 ...).\n"
+         "                                         SPICE raw files also take variable names (e.g. v(out),v(in))");
+    puts("    --complex (default mag)              part of the complex values of SPICE raw files (ac analysis) used as y: mag, db,\n"
+         "                                         phase (degrees), real or imag");
+    puts("    --y-is-integer                       y values are integers, not real numbers");
+    puts("    -s,--separator (default \",\")         input data separator");
+    puts("    -S,--print-separator (default \" \")   output data separator");
+    puts("    -k,--skip                            number of initial lines (header) to skip");
+    puts("    -r,--remove-redundant-points         remove points that add lines to output data, but not numerically (e.g. 42.2 and 42.2 as x coordinates for consecutive points)");
+    puts("    --sample                             take samples of the input data. Use with --sample-start and --sample-interval");
+    puts("    --sample                             take samples of the input data. Use with --sample-start and --sample-interval");
+    puts("    --sample-start                       start of sampling (x-coordinate)");
+    puts("    --sample-interval                    interval of sampling (x-coordinate)");
+    puts("    --sample-mode (default first)        first keeps the first point of every interval, linear and cubic interpolate exactly one\n"
+         "                                         point per grid step (start + k * interval), x has to increase");
+    //puts("    -f,--filter                          filter data (remove redundant points)");
+    puts("    --every-nth (default 1)              only keep every nth point");
+    puts("    --tolerance                          drop points that linear interpolation between the kept points reconstructs within\n"
+         "                                         this y tolerance (wide rows: in every series)");
+    puts("    --reduce                             reduce every series to at most this many points (after sampling and -r). Several series\n"
+         "                                         in one output share their rows, a row kept for any series prints all of them, so wide\n"
+         "                                         output holds up to (number of series) * this many rows (see --output-pattern)");
+    puts("    --reduce-mode (default lttb)         lttb (largest triangle three buckets) or minmax (smallest and largest y per bucket)");
+    puts("    --as-string                          don't do any numerical processing on y, equal strings are stored only once");
+    puts("    --digital                            interpret data as digital data, use with --threshold, only edges are kept");
+    puts("    --threshold (default 0.0)            threshold for digital data");
+    puts("    --hysteresis (default 0.0)           the level rises above threshold + hysteresis/2 and falls below threshold - hysteresis/2");
+    //puts("    --xstart (default -1e32)             minimum x datum");
+    //puts("    --xend (default 1e32)                maximum x datum");
+    //puts("    --xscale (default 1)                 factor for scaling x data");
+    //puts("    --yscale (default 1)                 factor for scaling y data");
+    puts("    --y-is-multibit                      map binary data (e.g. 101) to decimal (e.g. 5), every distinct string is decoded once");
+    //puts("    --ymin (default 0)                   minimum value for y map range");
+    //puts("    --ymax (default 0)                   maximum value for y map range");
+    puts("    --xprecision                         decimal digits for x data");
+    puts("    -j,--threads (default 1)             number of threads used for parsing the input and formatting the text output");
+    puts("    --y-float32                          store y values in single precision as long as this does not affect the output (see --yprecision),\n"
+         "                                         ignored with -r, --tolerance, --digital, --reduce and interpolating --sample-mode");
+    puts("    --no-fuse                            apply --xscale, --xshift, --yscale, --yshift, --xmin and --xmax one after another instead of\n"
+         "                                         folding them into one pass (same output, --stats then counts every filter on its own)");
+    puts("    --output-format (default text)       text or bin, bin writes all points as columnar binary data, which is read back without\n"
+         "                                         parsing when given as input file (x and y are then column indices), vcd writes a\n"
+         "                                         value change dump of the digital data (implies --digital)");
+    puts("    --vcd-timescale (default 1ps)        time unit of the vcd output, x is taken as seconds");
+    puts("    --output-pattern                     write every series to its own file, %d in the pattern is replaced by the y index");
+    puts("    --build-index                        write an index sidecar (<filename>.fdidx) for files with monotone x, later runs use it\n"
+         "                                         to only parse the rows selected by --xmin/--xmax");
+    puts("    --index-stride (default 4096)        number of rows between index entries");
+    puts("    --stream                             process the input chunk by chunk with constant memory, output starts immediately");
+    puts("    --follow                             keep reading a file that is still being written (like tail -f), implies --stream.\n"
+         "                                         Stops on SIGINT/SIGTERM, when the file is removed or after --follow-timeout");
+    puts("    --follow-timeout (default 0)         stop following after this many seconds without new data, 0 waits forever");
+    puts("    --checkpoint                         save the read position and the pipeline state of --follow to this file and\n"
+         "                                         resume from it on the next start (append the output, e.g. with >>)");
+    puts("    --yprecision                         decimal digits for y data");
+    puts("    --stats                              report time, cpu time and removed points per stage, bytes, rows and peak memory on stderr");
+    puts("    --stats-format (default text)        text or json, implies --stats");
+    //puts("    --xshift (default 0)                 shift x values");
+    //puts("    --x-relative                         output relative x values");
+}
+
+static int _arg_is(const char* arg, const char* short_arg, const char* long_arg)
+{
+    if(short_arg && strcmp(arg, short_arg) == 0)
+    {
+        return 1;
+    }
+    if(long_arg && strcmp(arg, long_arg) == 0)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+static int _has_arg(int argc, char** argv, const char* short_arg, const char* long_arg)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], short_arg, long_arg))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static size_t _get_skiplines(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], "-k", "--skip"))
+        {
+            if(i < argc - 1)
+            {
+                return atoi(argv[i + 1]);
+            }
+        }
+    }
+    return 0;
+}
+
+static int _get_xdecimals(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--xprecision"))
+        {
+            if(i < argc - 1)
+            {
+                return atoi(argv[i + 1]);
+            }
+        }
+    }
+    return 16;
+}
+
+static int _get_ydecimals(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--yprecision"))
+        {
+            if(i < argc - 1)
+            {
+                return atoi(argv[i + 1]);
+            }
+        }
+    }
+    return 16;
+}
+
+static double _get_sample_start(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--sample-start"))
+        {
+            if(i < argc - 1)
+            {
+                return atof(argv[i + 1]);
+            }
+        }
+    }
+    return 0.0;
+}
+
+static double _get_sample_interval(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--sample-interval"))
+        {
+            if(i < argc - 1)
+            {
+                return atof(argv[i + 1]);
+            }
+        }
+    }
+    return 0.0;
+}
+
+static unsigned int _get_threads(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], "-j", "--threads"))
+        {
+            if(i < argc - 1)
+            {
+                int threads = atoi(argv[i + 1]);
+                return threads > 0 ? threads : 1;
+            }
+        }
+    }
+    return 1;
+}
+
+static size_t _get_index_stride(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--index-stride"))
+        {
+            if(i < argc - 1)
+            {
+                long stride = atol(argv[i + 1]);
+                return stride > 0 ? stride : DEFAULT_INDEX_STRIDE;
+            }
+        }
+    }
+    return DEFAULT_INDEX_STRIDE;
+}
+
+// list of y columns: single indices and ranges separated by commas, e.g. 1,3-5
+static unsigned int* _parse_columns(const char* str, size_t* numcolumns)
+{
+    size_t capacity = 8;
+    size_t count = 0;
+    unsigned int* columns = malloc(sizeof(*columns) * capacity);
+    const char* pos = str;
+    while(1)
+    {
+        char* end;
+        unsigned long first = strtoul(pos, &end, 10);
+        unsigned long last = first;
+        int valid = (end != pos) && _is_digit(*pos);
+        if(valid && (*end == '-'))
+        {
+            pos = end + 1;
+            last = strtoul(pos, &end, 10);
+            valid = (end != pos) && _is_digit(*pos) && (last >= first);
+        }
+        if(!valid || (last > UINT_MAX) || ((*end != ',') && (*end != 0)))
+        {
+            fprintf(stderr, "filter_data: invalid y column list '%s'\n", str);
+            free(columns);
+            return NULL;
+        }
+        for(unsigned long column = first; column <= last; ++column)
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                if(columns[i] == column)
+                {
+                    fprintf(stderr, "filter_data: y column %lu is given twice\n", column);
+                    free(columns);
+                    return NULL;
+                }
+            }
+            if(count == capacity)
+            {
+                capacity *= 2;
+                columns = realloc(columns, sizeof(*columns) * capacity);
+            }
+            columns[count] = column;
+            ++count;
+        }
+        if(*end == 0)
+        {
+            break;
+        }
+        pos = end + 1;
+    }
+    *numcolumns = count;
+    return columns;
+}
+
+// streaming only reads text, raw files are detected up front
+static int _is_spice_raw_file(const char* filename)
+{
+    char buf[9];
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        return 0;
+    }
+    ssize_t ret = read(fd, buf, sizeof(buf));
+    close(fd);
+    return (ret > 0) && _is_spice_raw(buf, ret);
+}
+
+static int _is_column_list(const char* str)
+{
+    for(; *str; ++str)
+    {
+        if(!_is_digit(*str) && (*str != ',') && (*str != '-'))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// variable names (e.g. time v(out),v(in)) instead of column indices, only SPICE raw files
+// name their columns. Numeric arguments are taken as indices as usual
+static int resolve_spice_names(const char* filename, const char* xname, const char* ynames, unsigned int* xindex, unsigned int** yindices, size_t* numseries)
+{
+    struct input* input = strcmp(filename, "-") == 0 ? NULL : open_input(filename);
+    if(!input || !_is_spice_raw(input->data, input->size))
+    {
+        fputs("filter_data: variable names can only be given for SPICE raw files\n", stderr);
+        if(input)
+        {
+            close_input(input);
+        }
+        return 0;
+    }
+    struct spice_header header;
+    if(!_parse_spice_header(input, &header))
+    {
+        close_input(input);
+        return 0;
+    }
+    int ok = 1;
+    if(_is_column_list(xname))
+    {
+        *xindex = atoi(xname);
+    }
+    else
+    {
+        *xindex = _find_spice_variable(&header, xname, strlen(xname));
+        if(*xindex == UINT_MAX)
+        {
+            fprintf(stderr, "filter_data: unknown variable '%s'\n", xname);
+            ok = 0;
+        }
+    }
+    if(_is_column_list(ynames))
+    {
+        *yindices = _parse_columns(ynames, numseries);
+        ok = ok && *yindices;
+    }
+    else
+    {
+        size_t count = 0;
+        *yindices = malloc(sizeof(**yindices) * (strlen(ynames) / 2 + 1));
+        const char* name = ynames;
+        while(ok)
+        {
+            const char* comma = strchr(name, ',');
+            size_t length = comma ? (size_t)(comma - name) : strlen(name);
+            unsigned int index = _find_spice_variable(&header, name, length);
+            if(index == UINT_MAX)
+            {
+                fprintf(stderr, "filter_data: unknown variable '%.*s'\n", (int)length, name);
+                ok = 0;
+                break;
+            }
+            (*yindices)[count] = index;
+            ++count;
+            if(!comma)
+            {
+                break;
+            }
+            name = comma + 1;
+        }
+        *numseries = count;
+    }
+    if(!ok)
+    {
+        free(*yindices);
+        *yindices = NULL;
+    }
+    _destroy_spice_header(&header);
+    close_input(input);
+    return ok;
+}
+
+static double _get_threshold(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--threshold"))
+        {
+            if(i < argc - 1)
+            {
+                return atof(argv[i + 1]);
+            }
+        }
+    }
+    return 0.0;
+}
+
+static double _get_hysteresis(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--hysteresis"))
+        {
+            if(i < argc - 1)
+            {
+                return atof(argv[i + 1]);
+            }
+        }
+    }
+    return 0.0;
+}
+
+static const char* _get_vcd_timescale(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--vcd-timescale"))
+        {
+            if(i < argc - 1)
+            {
+                return argv[i + 1];
+            }
+        }
+    }
+    return "1ps";
+}
+
+static double _get_tolerance(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--tolerance"))
+        {
+            if(i < argc - 1)
+            {
+                return atof(argv[i + 1]);
+            }
+        }
+    }
+    return 0.0;
+}
+
+static double _get_follow_timeout(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--follow-timeout"))
+        {
+            if(i < argc - 1)
+            {
+                return atof(argv[i + 1]);
+            }
+        }
+    }
+    return 0.0;
+}
+
+static const char* _get_checkpoint(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--checkpoint"))
+        {
+            if(i < argc - 1)
+            {
+                return argv[i + 1];
+            }
+        }
+    }
+    return NULL;
+}
+
+static size_t _get_reduce(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--reduce"))
+        {
+            if(i < argc - 1)
+            {
+                long target = atol(argv[i + 1]);
+                return target > 0 ? target : 0;
+            }
+        }
+    }
+    return 0;
+}
+
+static const char* _get_reduce_mode(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--reduce-mode"))
+        {
+            if(i < argc - 1)
+            {
+                return argv[i + 1];
+            }
+        }
+    }
+    return "lttb";
+}
+
+static const char* _get_output_pattern(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--output-pattern"))
+        {
+            if(i < argc - 1)
+            {
+                return argv[i + 1];
+            }
+        }
+    }
+    return NULL;
+}
+
+static const char* _get_output_format(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--output-format"))
+        {
+            if(i < argc - 1)
+            {
+                return argv[i + 1];
+            }
+        }
+    }
+    return "text";
+}
+
+static const char* _get_stats_format(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--stats-format"))
+        {
+            if(i < argc - 1)
+            {
+                return argv[i + 1];
+            }
+        }
+    }
+    return "text";
+}
+
+static int _get_sample_mode(int argc, char** argv, enum sample_mode* mode)
+{
+    const char* name = "first";
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--sample-mode"))
+        {
+            if(i < argc - 1)
+            {
+                name = argv[i + 1];
+            }
+        }
+    }
+    static const char* const names[] = { "first", "linear", "cubic" };
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        if(strcmp(name, names[i]) == 0)
+        {
+            *mode = (enum sample_mode)i;
+            return 1;
+        }
+    }
+    fprintf(stderr, "filter_data: unknown sample mode '%s'\n", name);
+    return 0;
+}
+
+static int _get_complex_part(int argc, char** argv, enum complex_part* part)
+{
+    const char* name = "mag";
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], NULL, "--complex"))
+        {
+            if(i < argc - 1)
+            {
+                name = argv[i + 1];
+            }
+        }
+    }
+    static const char* const names[] = { "mag", "db", "phase", "real", "imag" };
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        if(strcmp(name, names[i]) == 0)
+        {
+            *part = (enum complex_part)i;
+            return 1;
+        }
+    }
+    fprintf(stderr, "filter_data: unknown complex part '%s'\n", name);
+    return 0;
+}
+
+static char* _get_separator(int argc, char** argv, const char* default_sep)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], "-s", "--separator"))
+        {
+            if(i < argc - 1)
+            {
+                return strdup(argv[i + 1]);
+            }
+        }
+    }
+    return strdup(default_sep);
+}
+
+static char* _get_print_separator(int argc, char** argv, const char* default_sep)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(_arg_is(argv[i], "-S", "--print-separator"))
+        {
+            if(i < argc - 1)
+            {
+                return strdup(argv[i + 1]);
+            }
+        }
+    }
+    return strdup(default_sep);
+}
+
+static int _is_equal(double x1, double x2, double precision)
+{
+    return fabs(x1 - x2) < precision;
+}
+
+// the post-processing steps only ever look at the last kept point, so they can
+// run on the complete data as well as point by point on a stream
+struct redundancy_state {
+    double xprecision;
+    double yprecision;
+    int initialized;
+    double lastx;
+    struct yvalue lasty;
+};
+
+static void _init_redundancy_state(struct redundancy_state* state, int xdecimals, int ydecimals)
+{
+    state->xprecision = pow(10, -xdecimals);
+    state->yprecision = pow(10, -ydecimals);
+    state->initialized = 0;
+}
+
+// x and y are checked independently, each against the last point that differed in that coordinate
+static int _is_redundant(struct redundancy_state* state, const struct xydatum* datum)
+{
+    if(!state->initialized)
+    {
+        state->initialized = 1;
+        state->lastx = datum->x;
+        state->lasty = datum->y;
+        return 0;
+    }
+    int redundant = 0;
+    // x-filter
+    if(_is_equal(datum->x, state->lastx, state->xprecision))
+    {
+        redundant = 1;
+    }
+    else
+    {
+        state->lastx = datum->x;
+    }
+    // y-filter
+    int advance = 1;
+    switch(state->lasty.type)
+    {
+        case REAL:
+            advance = !_is_equal(datum->y.d, state->lasty.d, state->yprecision);
+            break;
+        case INTEGER:
+            advance = !(datum->y.i == state->lasty.i);
+            break;
+        case STRING:
+            // strings are interned
+            advance = datum->y.str != state->lasty.str;
+            break;
+    }
+    if(advance)
+    {
+        state->lasty = datum->y;
+    }
+    else
+    {
+        redundant = 1;
+    }
+    return redundant;
+}
+
+// every series is checked on its own
+static void _remove_redundant_points(struct data* data, int xdecimals, int ydecimals)
+{
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        struct redundancy_state state;
+        _init_redundancy_state(&state, xdecimals, ydecimals);
+        // find redundant points and mark the as deleted
+        for(size_t i = 0; i < data->length; ++i)
+        {
+            struct xydatum datum;
+            _get_datum(data, s, i, &datum);
+            if(_is_redundant(&state, &datum))
+            {
+                _mark_deleted(data->series + s, i);
+            }
+        }
+    }
+}
+
+struct sample_state {
+    double start;
+    double interval;
+    size_t index;
+};
+
+static void _init_sample_state(struct sample_state* state, double samplestart, double sampleinterval)
+{
+    state->start = samplestart;
+    state->interval = sampleinterval;
+    state->index = 0;
+}
+
+static int _is_sampled(struct sample_state* state, double x)
+{
+    // FIXME: assumes monotone data, implement check?
+    if(x < state->start)
+    {
+        return 0;
+    }
+    size_t index = (x - state->start) / state->interval;
+    if(index > state->index)
+    {
+        state->index = index;
+        return 1;
+    }
+    return 0;
+}
+
+static void _sample_data(struct data* data, double samplestart, double sampleinterval)
+{
+    struct sample_state state;
+    _init_sample_state(&state, samplestart, sampleinterval);
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        if(!_is_sampled(&state, data->x[i]))
+        {
+            _mark_row_deleted(data, i);
+        }
+    }
+}
+
+// interpolating resampler (--sample-mode linear or cubic): exactly one point per grid step
+// start + k * interval between the first and the last input point, its y values are
+// interpolated between the input points around it. The input is swept once, point by point.
+// Cubic interpolation (hermite, the slopes are those of the parabola through a point and its
+// neighbours) also needs the point after an interval, so its output lags one point behind.
+// Points with decreasing x can't be placed on the grid and are skipped, for equal x (steps)
+// the last value is taken
+struct resampler {
+    enum sample_mode mode;
+    double start;
+    double interval;
+    size_t numseries;
+    size_t numpoints; // input points taken so far
+    double x[2]; // the last points, linear only holds one
+    double* y; // y of point j in series s at j * numseries + s
+    double* slope; // cubic: slopes at x[0] and x[1] of every series
+    int started; // cubic: the slopes at x[0] are set
+    double* values; // interpolated y of the current grid point
+    size_t next; // grid index of the next output point
+    size_t skipped; // points with decreasing x
+    void (*emit)(void* arg, double x, const double* y);
+    void* arg;
+    size_t numinput; // for --stats
+    size_t numoutput;
+};
+
+static struct resampler* create_resampler(enum sample_mode mode, double start, double interval, size_t numseries, void (*emit)(void* arg, double x, const double* y), void* arg)
+{
+    struct resampler* resampler = calloc(1, sizeof(*resampler));
+    resampler->mode = mode;
+    resampler->start = start;
+    resampler->interval = interval;
+    resampler->numseries = numseries;
+    resampler->y = malloc(sizeof(*resampler->y) * 2 * numseries);
+    resampler->slope = malloc(sizeof(*resampler->slope) * 2 * numseries);
+    resampler->values = malloc(sizeof(*resampler->values) * numseries);
+    resampler->emit = emit;
+    resampler->arg = arg;
+    return resampler;
+}
+
+static void destroy_resampler(struct resampler* resampler)
+{
+    free(resampler->y);
+    free(resampler->slope);
+    free(resampler->values);
+    free(resampler);
+}
+
+// grid points in [x[0], x[1]), or [x[0], x[1]] at the end of the input
+static void _resample_interval(struct resampler* resampler, int last)
+{
+    size_t numseries = resampler->numseries;
+    double xa = resampler->x[0];
+    double xb = resampler->x[1];
+    const double* ya = resampler->y;
+    const double* yb = resampler->y + numseries;
+    double h = xb - xa;
+    while(1)
+    {
+        double x = resampler->start + resampler->next * resampler->interval;
+        if(!(x < xb) && !(last && (x == xb)))
+        {
+            break;
+        }
+        double t = h > 0.0 ? (x - xa) / h : 1.0;
+        if(resampler->mode == SAMPLE_CUBIC)
+        {
+            double t2 = t * t;
+            double t3 = t2 * t;
+            double h00 = 2.0 * t3 - 3.0 * t2 + 1.0;
+            double h10 = (t3 - 2.0 * t2 + t) * h;
+            double h01 = 3.0 * t2 - 2.0 * t3;
+            double h11 = (t3 - t2) * h;
+            const double* ma = resampler->slope;
+            const double* mb = resampler->slope + numseries;
+            for(size_t s = 0; s < numseries; ++s)
+            {
+                resampler->values[s] = h00 * ya[s] + h10 * ma[s] + h01 * yb[s] + h11 * mb[s];
+            }
+        }
+        else
+        {
+            for(size_t s = 0; s < numseries; ++s)
+            {
+                resampler->values[s] = ya[s] + t * (yb[s] - ya[s]);
+            }
+        }
+        resampler->emit(resampler->arg, x, resampler->values);
+        ++resampler->next;
+        ++resampler->numoutput;
+    }
+}
+
+static void _hold_point(struct resampler* resampler, size_t slot, double x, const double* y)
+{
+    resampler->x[slot] = x;
+    memcpy(resampler->y + slot * resampler->numseries, y, sizeof(*y) * resampler->numseries);
+}
+
+// cubic: the slope at x[0] of the first interval and at the end of the last one is the secant
+static void _secant_slopes(struct resampler* resampler, double* slope)
+{
+    size_t numseries = resampler->numseries;
+    double h = resampler->x[1] - resampler->x[0];
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        slope[s] = (resampler->y[numseries + s] - resampler->y[s]) / h;
+    }
+}
+
+static void resampler_push(struct resampler* resampler, double x, const double* y)
+{
+    size_t numseries = resampler->numseries;
+    ++resampler->numinput;
+    if(resampler->numpoints == 0)
+    {
+        _hold_point(resampler, 0, x, y);
+        resampler->numpoints = 1;
+        // the first grid point at or after the first input point
+        double first = (x - resampler->start) / resampler->interval;
+        resampler->next = first > 0.0 ? (size_t)ceil(first) : 0;
+        while((resampler->next > 0) && (resampler->start + (resampler->next - 1) * resampler->interval >= x))
+        {
+            --resampler->next;
+        }
+        while(resampler->start + resampler->next * resampler->interval < x)
+        {
+            ++resampler->next;
+        }
+        return;
+    }
+    size_t newest = resampler->numpoints - 1;
+    if(x == resampler->x[newest])
+    {
+        // a step, the later value counts
+        _hold_point(resampler, newest, x, y);
+        return;
+    }
+    if(!(x > resampler->x[newest]))
+    {
+        if(resampler->skipped == 0)
+        {
+            fprintf(stderr, "filter_data: x is not monotone (%g after %g), --sample skips such points\n", x, resampler->x[newest]);
+        }
+        ++resampler->skipped;
+        return;
+    }
+    if(resampler->mode != SAMPLE_CUBIC)
+    {
+        _hold_point(resampler, 1, x, y);
+        _resample_interval(resampler, 0);
+        _hold_point(resampler, 0, x, y);
+        return;
+    }
+    if(resampler->numpoints == 1)
+    {
+        _hold_point(resampler, 1, x, y);
+        resampler->numpoints = 2;
+        return;
+    }
+    // slope at x[1] from the parabola through x[0], x[1] and x
+    double h0 = resampler->x[1] - resampler->x[0];
+    double h1 = x - resampler->x[1];
+    const double* y0 = resampler->y;
+    const double* y1 = resampler->y + numseries;
+    double* ma = resampler->slope;
+    double* mb = resampler->slope + numseries;
+    if(!resampler->started)
+    {
+        _secant_slopes(resampler, ma);
+        resampler->started = 1;
+    }
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        double d0 = (y1[s] - y0[s]) / h0;
+        double d1 = (y[s] - y1[s]) / h1;
+        mb[s] = (h1 * d0 + h0 * d1) / (h0 + h1);
+    }
+    _resample_interval(resampler, 0);
+    memcpy(ma, mb, sizeof(*ma) * numseries);
+    _hold_point(resampler, 0, resampler->x[1], y1);
+    _hold_point(resampler, 1, x, y);
+}
+
+// the remaining grid points up to and including the last input point
+static void finish_resampler(struct resampler* resampler)
+{
+    size_t numseries = resampler->numseries;
+    if(resampler->numpoints == 0)
+    {
+        return;
+    }
+    if((resampler->mode != SAMPLE_CUBIC) || (resampler->numpoints == 1))
+    {
+        _hold_point(resampler, 1, resampler->x[0], resampler->y);
+        _resample_interval(resampler, 1);
+        return;
+    }
+    if(!resampler->started)
+    {
+        _secant_slopes(resampler, resampler->slope);
+    }
+    _secant_slopes(resampler, resampler->slope + numseries);
+    _resample_interval(resampler, 1);
+}
+
+static void _append_resampled(void* arg, double x, const double* y)
+{
+    struct data* data = arg;
+    _reserve_data(data, data->length + 1);
+    data->x[data->length] = x;
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        data->series[s].y.d[data->length] = y[s];
+    }
+    ++data->length;
+}
+
+// the grid points replace the rows of data, rows are taken if they are live in any series
+static void _resample_data(struct data* data, enum sample_mode mode, double samplestart, double sampleinterval)
+{
+    struct data* resampled = _create_data(1024, data->numseries, REAL, -1);
+    struct resampler* resampler = create_resampler(mode, samplestart, sampleinterval, data->numseries, _append_resampled, resampled);
+    double* y = malloc(sizeof(*y) * data->numseries);
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        int live = 0;
+        for(size_t s = 0; s < data->numseries; ++s)
+        {
+            const struct series* series = data->series + s;
+            y[s] = series->yfloat ? series->y.f[i] : series->y.d[i];
+            live = live || !_is_deleted(series, i);
+        }
+        if(live)
+        {
+            resampler_push(resampler, data->x[i], y);
+        }
+    }
+    finish_resampler(resampler);
+    destroy_resampler(resampler);
+    free(y);
+    // the old rows are released with the resampled struct
+    struct data old = *data;
+    *data = *resampled;
+    *resampled = old;
+    _destroy_data(resampled);
+}
+
+// piecewise-linear compression
+// a point is dropped if linear interpolation between the kept points around it reconstructs
+// it within the tolerance. The state holds the last kept point (anchor), the last point that
+// can still end the current segment (pending) and for every series the range of slopes from
+// the anchor that stays within the tolerance of all points in between. A point whose slope
+// leaves this range can't end the segment, then the pending point is kept and becomes the new
+// anchor. Compressing several series jointly only drops points that fit in all of them
+struct compress_point {
+    double x;
+    struct yvalue* y;
+    size_t row;
+};
+
+struct compress_state {
+    double tolerance;
+    size_t numseries;
+    int hasanchor;
+    int haspending;
+    struct compress_point anchor;
+    struct compress_point pending;
+    double* slopemin;
+    double* slopemax;
+    struct compress_point kept[2]; // points kept by the last call, in order
+};
+
+static void _init_compress_state(struct compress_state* state, double tolerance, size_t numseries)
+{
+    state->tolerance = tolerance;
+    state->numseries = numseries;
+    state->hasanchor = 0;
+    state->haspending = 0;
+    state->anchor.y = malloc(sizeof(*state->anchor.y) * numseries);
+    state->pending.y = malloc(sizeof(*state->pending.y) * numseries);
+    state->kept[0].y = malloc(sizeof(*state->kept[0].y) * numseries);
+    state->kept[1].y = malloc(sizeof(*state->kept[1].y) * numseries);
+    state->slopemin = malloc(sizeof(*state->slopemin) * numseries);
+    state->slopemax = malloc(sizeof(*state->slopemax) * numseries);
+}
+
+static void _destroy_compress_state(struct compress_state* state)
+{
+    free(state->anchor.y);
+    free(state->pending.y);
+    free(state->kept[0].y);
+    free(state->kept[1].y);
+    free(state->slopemin);
+    free(state->slopemax);
+}
+
+static double _yvalue_as_double(const struct yvalue* y)
+{
+    switch(y->type)
+    {
+        case REAL:
+            return y->d;
+        case INTEGER:
+            return y->i;
+        case STRING:
+            return 0.0;
+    }
+    return 0.0;
+}
+
+static void _set_point(struct compress_point* point, size_t numseries, double x, const struct yvalue* y, size_t row)
+{
+    point->x = x;
+    memcpy(point->y, y, sizeof(*y) * numseries);
+    point->row = row;
+}
+
+static void _new_anchor(struct compress_state* state, const struct compress_point* point)
+{
+    _set_point(&state->anchor, state->numseries, point->x, point->y, point->row);
+    for(size_t s = 0; s < state->numseries; ++s)
+    {
+        state->slopemin[s] = -INFINITY;
+        state->slopemax[s] = INFINITY;
+    }
+    state->haspending = 0;
+}
+
+// the point can end the current segment
+static int _ends_segment(const struct compress_state* state, double x, const struct yvalue* y)
+{
+    double dx = x - state->anchor.x;
+    if(!(dx > 0.0))
+    {
+        return 0;
+    }
+    for(size_t s = 0; s < state->numseries; ++s)
+    {
+        double slope = (_yvalue_as_double(y + s) - _yvalue_as_double(state->anchor.y + s)) / dx;
+        if(!((slope >= state->slopemin[s]) && (slope <= state->slopemax[s])))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void _add_pending(struct compress_state* state, double x, const struct yvalue* y, size_t row)
+{
+    double dx = x - state->anchor.x;
+    for(size_t s = 0; s < state->numseries; ++s)
+    {
+        double dy = _yvalue_as_double(y + s) - _yvalue_as_double(state->anchor.y + s);
+        state->slopemin[s] = fmax(state->slopemin[s], (dy - state->tolerance) / dx);
+        state->slopemax[s] = fmin(state->slopemax[s], (dy + state->tolerance) / dx);
+    }
+    _set_point(&state->pending, state->numseries, x, y, row);
+    state->haspending = 1;
+}
+
+// returns the number of points that are kept (in state->kept)
+static size_t _compress_point(struct compress_state* state, double x, const struct yvalue* y, size_t row)
+{
+    if(!state->hasanchor)
+    {
+        // the first point is always kept
+        _set_point(state->kept, state->numseries, x, y, row);
+        _new_anchor(state, state->kept);
+        state->hasanchor = 1;
+        return 1;
+    }
+    if(_ends_segment(state, x, y))
+    {
+        _add_pending(state, x, y, row);
+        return 0;
+    }
+    size_t numkept = 0;
+    if(state->haspending)
+    {
+        _set_point(state->kept + numkept, state->numseries, state->pending.x, state->pending.y, state->pending.row);
+        _new_anchor(state, state->kept + numkept);
+        ++numkept;
+        if(_ends_segment(state, x, y))
+        {
+            _add_pending(state, x, y, row);
+            return numkept;
+        }
+    }
+    // not representable by a line from the anchor (e.g. equal x)
+    _set_point(state->kept + numkept, state->numseries, x, y, row);
+    _new_anchor(state, state->kept + numkept);
+    ++numkept;
+    return numkept;
+}
+
+// keep the last point
+static size_t _finish_compress(struct compress_state* state)
+{
+    if(!state->haspending)
+    {
+        return 0;
+    }
+    _set_point(state->kept, state->numseries, state->pending.x, state->pending.y, state->pending.row);
+    state->haspending = 0;
+    return 1;
+}
+
+// jointly: a row is dropped in all series if every series can be interpolated there, wide
+// rows then stay within the tolerance for every series. Otherwise each series on its own
+static void _compress_data(struct data* data, double tolerance, int jointly)
+{
+    size_t numgroups = jointly ? 1 : data->numseries;
+    size_t groupsize = jointly ? data->numseries : 1;
+    struct yvalue* y = malloc(sizeof(*y) * groupsize);
+    uint64_t* kept = malloc(sizeof(*kept) * _bitmap_words(data->length > 0 ? data->length : 1));
+    for(size_t g = 0; g < numgroups; ++g)
+    {
+        struct compress_state state;
+        _init_compress_state(&state, tolerance, groupsize);
+        memset(kept, 0, sizeof(*kept) * _bitmap_words(data->length > 0 ? data->length : 1));
+        for(size_t i = 0; i <= data->length; ++i)
+        {
+            size_t numkept;
+            if(i == data->length)
+            {
+                numkept = _finish_compress(&state);
+            }
+            else
+            {
+                int live = 0;
+                for(size_t s = 0; s < groupsize; ++s)
+                {
+                    live = live || !_is_deleted(data->series + g + s, i);
+                }
+                if(!live)
+                {
+                    continue;
+                }
+                for(size_t s = 0; s < groupsize; ++s)
+                {
+                    struct xydatum datum;
+                    _get_datum(data, g + s, i, &datum);
+                    y[s] = datum.y;
+                }
+                numkept = _compress_point(&state, data->x[i], y, i);
+            }
+            for(size_t k = 0; k < numkept; ++k)
+            {
+                size_t row = state.kept[k].row;
+                kept[row / 64] |= 1ull << (row % 64);
+            }
+        }
+        for(size_t i = 0; i < data->length; ++i)
+        {
+            if(!((kept[i / 64] >> (i % 64)) & 1))
+            {
+                for(size_t s = 0; s < groupsize; ++s)
+                {
+                    _mark_deleted(data->series + g + s, i);
+                }
+            }
+        }
+        _destroy_compress_state(&state);
+    }
+    free(kept);
+    free(y);
+}
+
+// digital signals
+// y is turned into a logic level: with a hysteresis the level only rises above threshold + hysteresis / 2
+// and only falls below threshold - hysteresis / 2. Only points where the level changed are kept
+struct digital_state {
+    double threshold;
+    double rise;
+    double fall;
+    int level; // -1 before the first point
+    int printed; // last level that was kept, -1 before the first point
+};
+
+static void _init_digital_state(struct digital_state* state, double threshold, double hysteresis)
+{
+    state->threshold = threshold;
+    state->rise = threshold + hysteresis / 2;
+    state->fall = threshold - hysteresis / 2;
+    state->level = -1;
+    state->printed = -1;
+}
+
+static int _digitize(struct digital_state* state, double y)
+{
+    if(state->level < 0)
+    {
+        state->level = y > state->threshold;
+    }
+    else if(state->level)
+    {
+        state->level = !(y <= state->fall);
+    }
+    else
+    {
+        state->level = y > state->rise;
+    }
+    return state->level;
+}
+
+// replace every series by its logic level and delete all points that are not edges
+// an edge only counts as printed if the point survives -r (removed afterwards by
+// _remove_redundant_points, which sees the same levels), printed rows of jointly output series
+// update the printed level of every series. This is what the streaming pipeline does row by row
+static void _digitize_data(struct data* data, double threshold, double hysteresis, int remove_redundant, int xdecimals, int ydecimals, int jointly)
+{
+    size_t numseries = data->numseries;
+    struct digital_state* states = malloc(sizeof(*states) * numseries);
+    struct redundancy_state* redundancy = malloc(sizeof(*redundancy) * numseries);
+    int** levels = malloc(sizeof(*levels) * numseries);
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        _init_digital_state(states + s, threshold, hysteresis);
+        _init_redundancy_state(redundancy + s, xdecimals, ydecimals);
+        levels[s] = malloc(sizeof(*levels[s]) * data->capacity);
+    }
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        int anykept = 0;
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            struct series* series = data->series + s;
+            struct xydatum datum;
+            _get_datum(data, s, i, &datum);
+            int level = _digitize(states + s, _yvalue_as_double(&datum.y));
+            levels[s][i] = level;
+            int kept = !_is_deleted(series, i);
+            if(kept && (level == states[s].printed))
+            {
+                _mark_deleted(series, i);
+                kept = 0;
+            }
+            if(remove_redundant)
+            {
+                datum.y.type = INTEGER;
+                datum.y.i = level;
+                kept = !_is_redundant(redundancy + s, &datum) && kept;
+            }
+            if(kept && !jointly)
+            {
+                states[s].printed = level;
+            }
+            anykept = anykept || kept;
+        }
+        if(anykept && jointly)
+        {
+            for(size_t s = 0; s < numseries; ++s)
+            {
+                states[s].printed = levels[s][i];
+            }
+        }
+    }
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        struct series* series = data->series + s;
+        if(!data->input)
+        {
+            free(series->y.d);
+        }
+        series->y.i = levels[s];
+        series->ytype = INTEGER;
+        series->yfloat = 0;
+    }
+    free(states);
+    free(redundancy);
+    free(levels);
+    if(data->input)
+    {
+        // the levels don't point into the input anymore
+        double* x = malloc(sizeof(*x) * data->capacity);
+        memcpy(x, data->x, sizeof(*x) * data->length);
+        data->x = x;
+        close_input(data->input);
+        data->input = NULL;
+    }
+}
+
+// decimation to a target number of points
+// the live points of a series are split into buckets of equal point count, the first and the
+// last point are always kept. minmax keeps the smallest and the largest y of every bucket, lttb
+// (largest triangle three buckets) keeps the point of every bucket that spans the largest
+// triangle with the previously kept point and the average of the next bucket
+enum reduce_mode {
+    REDUCE_LTTB,
+    REDUCE_MINMAX
+};
+
+static size_t _count_live(const struct series* series, size_t length)
+{
+    size_t live = 0;
+    for(size_t w = 0; w < _bitmap_words(length); ++w)
+    {
+        uint64_t deleted = series->deleted[w];
+        if((w + 1) * 64 > length)
+        {
+            deleted |= ~0ull << (length % 64);
+        }
+        live += 64 - __builtin_popcountll(deleted);
+    }
+    return live;
+}
+
+static double _series_value(const struct series* series, size_t i)
+{
+    switch(series->ytype)
+    {
+        case REAL:
+            return series->yfloat ? series->y.f[i] : series->y.d[i];
+        case INTEGER:
+            return series->y.i[i];
+        case STRING:
+            return 0.0;
+    }
+    return 0.0;
+}
+
+// delete all live points that are not listed in keep (ascending row indices)
+static void _keep_rows(const struct data* data, struct series* series, const size_t* keep, size_t numkeep)
+{
+    size_t k = 0;
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        if((k < numkeep) && (keep[k] == i))
+        {
+            ++k;
+        }
+        else
+        {
+            _mark_deleted(series, i);
+        }
+    }
+}
+
+static size_t _reduce_minmax(const struct data* data, const struct series* series, size_t live, size_t target, size_t* keep)
+{
+    size_t numbuckets = (target - 2) / 2;
+    size_t numkeep = 0;
+    size_t rank = 0;
+    size_t bucket = 0;
+    size_t minrow = 0;
+    size_t maxrow = 0;
+    int empty = 1;
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        if(_is_deleted(series, i))
+        {
+            continue;
+        }
+        if((rank == 0) || (rank == live - 1))
+        {
+            if(!empty)
+            {
+                keep[numkeep++] = minrow < maxrow ? minrow : maxrow;
+                if(minrow != maxrow)
+                {
+                    keep[numkeep++] = minrow < maxrow ? maxrow : minrow;
+                }
+            }
+            keep[numkeep++] = i;
+            ++rank;
+            continue;
+        }
+        size_t b = (rank - 1) * numbuckets / (live - 2);
+        if(!empty && (b != bucket))
+        {
+            keep[numkeep++] = minrow < maxrow ? minrow : maxrow;
+            if(minrow != maxrow)
+            {
+                keep[numkeep++] = minrow < maxrow ? maxrow : minrow;
+            }
+            empty = 1;
+        }
+        double y = _series_value(series, i);
+        if(empty)
+        {
+            bucket = b;
+            minrow = i;
+            maxrow = i;
+            empty = 0;
+        }
+        else
+        {
+            if(y < _series_value(series, minrow))
+            {
+                minrow = i;
+            }
+            if(y > _series_value(series, maxrow))
+            {
+                maxrow = i;
+            }
+        }
+        ++rank;
+    }
+    return numkeep;
+}
+
+static size_t _reduce_lttb(const struct data* data, const struct series* series, size_t live, size_t target, size_t* keep)
+{
+    size_t numbuckets = target - 2;
+    // first pass: averages of all buckets
+    double* avgx = calloc(numbuckets, sizeof(*avgx));
+    double* avgy = calloc(numbuckets, sizeof(*avgy));
+    size_t* count = calloc(numbuckets, sizeof(*count));
+    size_t rank = 0;
+    double lastx = 0.0;
+    double lasty = 0.0;
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        if(_is_deleted(series, i))
+        {
+            continue;
+        }
+        if((rank > 0) && (rank < live - 1))
+        {
+            size_t b = (rank - 1) * numbuckets / (live - 2);
+            avgx[b] += data->x[i];
+            avgy[b] += _series_value(series, i);
+            ++count[b];
+        }
+        lastx = data->x[i];
+        lasty = _series_value(series, i);
+        ++rank;
+    }
+    for(size_t b = 0; b < numbuckets; ++b)
+    {
+        avgx[b] /= count[b];
+        avgy[b] /= count[b];
+    }
+    // second pass: select one point per bucket
+    size_t numkeep = 0;
+    double ax = 0.0;
+    double ay = 0.0;
+    size_t bucket = 0;
+    size_t best = 0;
+    double bestarea = -1.0;
+    rank = 0;
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        if(_is_deleted(series, i))
+        {
+            continue;
+        }
+        double x = data->x[i];
+        double y = _series_value(series, i);
+        if((rank == 0) || (rank == live - 1))
+        {
+            if(bestarea >= 0.0)
+            {
+                keep[numkeep++] = best;
+            }
+            keep[numkeep++] = i;
+            ax = x;
+            ay = y;
+            ++rank;
+            continue;
+        }
+        size_t b = (rank - 1) * numbuckets / (live - 2);
+        if(b != bucket)
+        {
+            keep[numkeep++] = best;
+            ax = data->x[best];
+            ay = _series_value(series, best);
+            bucket = b;
+            bestarea = -1.0;
+        }
+        double cx = b + 1 < numbuckets ? avgx[b + 1] : lastx;
+        double cy = b + 1 < numbuckets ? avgy[b + 1] : lasty;
+        double area = fabs((ax - cx) * (y - ay) - (ax - x) * (cy - ay));
+        if(area > bestarea)
+        {
+            bestarea = area;
+            best = i;
+        }
+        ++rank;
+    }
+    free(avgx);
+    free(avgy);
+    free(count);
+    return numkeep;
+}
+
+// every series is reduced on its own, printed as wide rows the output is the union of the rows
+// kept for each series
+static void _reduce_data(struct data* data, size_t target, enum reduce_mode mode)
+{
+    size_t* keep = malloc(sizeof(*keep) * target);
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        struct series* series = data->series + s;
+        size_t live = _count_live(series, data->length);
+        if(live <= target)
+        {
+            continue;
+        }
+        size_t numkeep;
+        switch(mode)
+        {
+            case REDUCE_MINMAX:
+                numkeep = _reduce_minmax(data, series, live, target, keep);
+                break;
+            case REDUCE_LTTB:
+            default:
+                numkeep = _reduce_lttb(data, series, live, target, keep);
+                break;
+        }
+        _keep_rows(data, series, keep, numkeep);
+    }
+    free(keep);
+}
+
+// buffered output
+// numbers are formatted directly into a large buffer, which is written out with write(2)
+struct output {
+    int fd;
+    char* buffer;
+    size_t length;
+    size_t capacity;
+    size_t written; // bytes flushed so far
+    int error;
+};
+
+static struct output* create_output(int fd)
+{
+    struct output* output = malloc(sizeof(*output));
+    output->fd = fd;
+    output->capacity = OUTPUT_BUFFER_SIZE;
+    output->buffer = malloc(output->capacity);
+    output->length = 0;
+    output->written = 0;
+    output->error = 0;
+    return output;
+}
+
+static void _write_all(int fd, const char* data, size_t size, int* error)
+{
+    while(size > 0)
+    {
+        ssize_t ret = write(fd, data, size);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            *error = 1;
+            return;
+        }
+        data += ret;
+        size -= ret;
+    }
+}
+
+static void flush_output(struct output* output)
+{
+    if(output->length > 0 && !output->error)
+    {
+        _write_all(output->fd, output->buffer, output->length, &output->error);
+    }
+    output->written += output->length;
+    output->length = 0;
+}
+
+// returns 0 if any write failed
+static int destroy_output(struct output* output)
+{
+    flush_output(output);
+    int ok = !output->error;
+    free(output->buffer);
+    free(output);
+    return ok;
+}
+
+// make room for at least size bytes
+// outputs without a file (fd < 0) only collect the text in memory, they grow instead
+static char* _output_reserve(struct output* output, size_t size)
+{
+    if(output->length + size > output->capacity)
+    {
+        if(output->fd < 0)
+        {
+            output->capacity = 2 * (output->length + size);
+            output->buffer = realloc(output->buffer, output->capacity);
+            return output->buffer + output->length;
+        }
+        flush_output(output);
+        if(size > output->capacity)
+        {
+            output->capacity = size;
+            output->buffer = realloc(output->buffer, output->capacity);
+        }
+    }
+    return output->buffer + output->length;
+}
+
+static void _output_string(struct output* output, const char* str, size_t length)
+{
+    memcpy(_output_reserve(output, length), str, length);
+    output->length += length;
+}
+
+static void _output_text(struct output* output, const char* str)
+{
+    _output_string(output, str, strlen(str));
+}
+
+// bytes written to a set of outputs, including what is still buffered
+static size_t _output_bytes(struct output* const* outputs, size_t numoutputs)
+{
+    size_t bytes = 0;
+    for(size_t i = 0; i < numoutputs; ++i)
+    {
+        bytes += outputs[i]->written + outputs[i]->length;
+    }
+    return bytes;
+}
+
+static size_t _format_uint(char* buf, uint64_t value)
+{
+    char tmp[20];
+    size_t length = 0;
+    do
+    {
+        tmp[length++] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+    for(size_t i = 0; i < length; ++i)
+    {
+        buf[i] = tmp[length - 1 - i];
+    }
+    return length;
+}
+
+static size_t _format_int(char* buf, int value)
+{
+    if(value < 0)
+    {
+        buf[0] = '-';
+        return 1 + _format_uint(buf + 1, -(int64_t)value);
+    }
+    return _format_uint(buf, value);
+}
+
+static const uint64_t _powers_of_ten[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull
+};
+
+// same output as printf("%.*f", decimals, value), buf must hold at least FORMAT_BUFFER_SIZE bytes
+// the value is m * 2^e exactly, so for moderate exponents m * 10^decimals fits into 128 bits and
+// can be rounded to an integer exactly (ties to even, like printf), everything else uses snprintf
+static size_t _format_fixed(char* buf, double value, int decimals)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int biased = (bits >> 52) & 0x7FF;
+    uint64_t mantissa = bits & ((1ull << 52) - 1);
+    int exponent;
+    if(biased == 0x7FF || decimals < 0 || decimals > MAX_FAST_DECIMALS)
+    {
+        return snprintf(buf, FORMAT_BUFFER_SIZE, "%.*f", decimals, value);
+    }
+    if(biased == 0)
+    {
+        exponent = -1074;
+    }
+    else
+    {
+        mantissa |= 1ull << 52;
+        exponent = biased - 1075;
+    }
+    uint64_t integer;
+    uint64_t fraction;
+    if(exponent >= 0)
+    {
+        if(exponent > 10)
+        {
+            return snprintf(buf, FORMAT_BUFFER_SIZE, "%.*f", decimals, value);
+        }
+        integer = mantissa << exponent;
+        fraction = 0;
+    }
+    else
+    {
+        unsigned __int128 scaled = (unsigned __int128)mantissa * _powers_of_ten[decimals];
+        unsigned __int128 q = 0;
+        // scaled < 2^117, so for larger shifts the result rounds to zero
+        if(-exponent < 118)
+        {
+            int shift = -exponent;
+            q = scaled >> shift;
+            unsigned __int128 remainder = scaled & (((unsigned __int128)1 << shift) - 1);
+            unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+            if((remainder > half) || ((remainder == half) && (q & 1)))
+            {
+                ++q;
+            }
+        }
+        integer = (uint64_t)(q / _powers_of_ten[decimals]);
+        fraction = (uint64_t)(q % _powers_of_ten[decimals]);
+    }
+    size_t length = 0;
+    if(bits >> 63)
+    {
+        buf[length++] = '-';
+    }
+    length += _format_uint(buf + length, integer);
+    if(decimals > 0)
+    {
+        buf[length++] = '.';
+        for(int i = decimals - 1; i >= 0; --i)
+        {
+            buf[length + i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        length += decimals;
+    }
+    return length;
+}
+
+static void _output_fixed(struct output* output, double value, int decimals)
+{
+    char* buf = _output_reserve(output, FORMAT_BUFFER_SIZE);
+    size_t length = _format_fixed(buf, value, decimals);
+    if(length >= FORMAT_BUFFER_SIZE)
+    {
+        // very large numbers with many decimals
+        char* tmp = malloc(length + 1);
+        snprintf(tmp, length + 1, "%.*f", decimals, value);
+        _output_string(output, tmp, length);
+        free(tmp);
+        return;
+    }
+    output->length += length;
+}
+
+static void _output_int(struct output* output, int value)
+{
+    output->length += _format_int(_output_reserve(output, 12), value);
+}
+
+static void _output_padding(struct output* output, size_t size)
+{
+    static const char zeros[8] = { 0 };
+    _output_string(output, zeros, _align8(size) - size);
+}
+
+static int write_binary(struct output* output, const struct data* data)
+{
+    if(!_is_little_endian())
+    {
+        fputs("filter_data: binary output is only supported on little-endian machines\n", stderr);
+        return 0;
+    }
+    size_t numcolumns = 1 + data->numseries;
+    uint8_t* types = malloc(numcolumns);
+    types[0] = BINARY_FLOAT64;
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        const struct series* series = data->series + s;
+        switch(series->ytype)
+        {
+            case REAL:
+                types[1 + s] = series->yfloat ? BINARY_FLOAT32 : BINARY_FLOAT64;
+                break;
+            case INTEGER:
+                types[1 + s] = BINARY_INT32;
+                break;
+            case STRING:
+                fputs("filter_data: string data can't be written in binary format\n", stderr);
+                free(types);
+                return 0;
+        }
+    }
+    struct binary_header header;
+    memcpy(header.magic, _binary_magic, sizeof(header.magic));
+    header.version = 1;
+    header.numcolumns = numcolumns;
+    header.numpoints = data->length;
+    _output_string(output, (const char*)&header, sizeof(header));
+    _output_string(output, (const char*)types, numcolumns);
+    _output_padding(output, sizeof(header) + numcolumns);
+    _output_string(output, (const char*)data->x, sizeof(*data->x) * data->length);
+    _output_padding(output, sizeof(*data->x) * data->length);
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        size_t ysize = _binary_type_size(types[1 + s]) * data->length;
+        _output_string(output, (const char*)data->series[s].y.d, ysize);
+        _output_padding(output, ysize);
+    }
+    free(types);
+    return 1;
+}
+
+// value change dump
+// every series becomes a wire named after its y column, only changed values are written
+struct vcd_writer {
+    struct output* output;
+    double timescale; // seconds per time unit
+    int started;
+    long long time;
+    size_t numseries;
+    int* values;
+    char (*ids)[VCD_ID_SIZE];
+};
+
+// 1, 10 or 100 followed by s, ms, us, ns, ps or fs
+static int _parse_timescale(const char* str, double* seconds)
+{
+    static const char* const units[] = { "s", "ms", "us", "ns", "ps", "fs" };
+    char* end;
+    long factor = strtol(str, &end, 10);
+    if((end == str) || ((factor != 1) && (factor != 10) && (factor != 100)))
+    {
+        return 0;
+    }
+    for(size_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i)
+    {
+        if(strcmp(end, units[i]) == 0)
+        {
+            *seconds = factor * pow(1000, -(double)i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static struct vcd_writer* create_vcd_writer(struct output* output, const char* timescale, const unsigned int* yindices, size_t numseries)
+{
+    double seconds;
+    if(!_parse_timescale(timescale, &seconds))
+    {
+        fprintf(stderr, "filter_data: invalid vcd timescale '%s'\n", timescale);
+        return NULL;
+    }
+    struct vcd_writer* vcd = malloc(sizeof(*vcd));
+    vcd->output = output;
+    vcd->timescale = seconds;
+    vcd->started = 0;
+    vcd->time = 0;
+    vcd->numseries = numseries;
+    vcd->values = malloc(sizeof(*vcd->values) * numseries);
+    vcd->ids = malloc(sizeof(*vcd->ids) * numseries);
+    _output_text(output, "$timescale ");
+    _output_string(output, timescale, strlen(timescale));
+    _output_text(output, " $end\n$scope module filter_data $end\n");
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        // identifiers are numbers in base 94, written with the printable characters
+        size_t n = s;
+        size_t length = 0;
+        do
+        {
+            vcd->ids[s][length++] = '!' + n % 94;
+            n /= 94;
+        } while(n > 0);
+        vcd->ids[s][length] = 0;
+        char number[FORMAT_BUFFER_SIZE];
+        _output_text(output, "$var wire 1 ");
+        _output_string(output, vcd->ids[s], length);
+        _output_text(output, " y");
+        _output_string(output, number, _format_uint(number, yindices[s]));
+        _output_text(output, " $end\n");
+    }
+    _output_text(output, "$upscope $end\n$enddefinitions $end\n");
+    return vcd;
+}
+
+static void _vcd_value(struct vcd_writer* vcd, size_t s, int value)
+{
+    char buf[FORMAT_BUFFER_SIZE];
+    if((value == 0) || (value == 1))
+    {
+        buf[0] = '0' + value;
+        _output_string(vcd->output, buf, 1);
+    }
+    else
+    {
+        // vector
+        size_t length = 0;
+        unsigned int v = value;
+        buf[length++] = 'b';
+        int bit = 31;
+        while((bit > 0) && !((v >> bit) & 1))
+        {
+            --bit;
+        }
+        for(; bit >= 0; --bit)
+        {
+            buf[length++] = '0' + ((v >> bit) & 1);
+        }
+        buf[length++] = ' ';
+        _output_string(vcd->output, buf, length);
+    }
+    _output_string(vcd->output, vcd->ids[s], strlen(vcd->ids[s]));
+    _output_string(vcd->output, "\n", 1);
+}
+
+static void _vcd_time(struct vcd_writer* vcd, long long time)
+{
+    char buf[FORMAT_BUFFER_SIZE];
+    buf[0] = '#';
+    size_t length = 1;
+    if(time < 0)
+    {
+        buf[length++] = '-';
+        length += _format_uint(buf + length, -(unsigned long long)time);
+    }
+    else
+    {
+        length += _format_uint(buf + length, time);
+    }
+    buf[length++] = '\n';
+    _output_string(vcd->output, buf, length);
+}
+
+// times that would go backwards are written at the last time
+static void vcd_row(struct vcd_writer* vcd, double x, const struct yvalue* y)
+{
+    long long time = llround(x / vcd->timescale);
+    if(!vcd->started)
+    {
+        vcd->time = time;
+        _vcd_time(vcd, time);
+        _output_text(vcd->output, "$dumpvars\n");
+        for(size_t s = 0; s < vcd->numseries; ++s)
+        {
+            vcd->values[s] = (int)_yvalue_as_double(y + s);
+            _vcd_value(vcd, s, vcd->values[s]);
+        }
+        _output_text(vcd->output, "$end\n");
+        vcd->started = 1;
+        return;
+    }
+    int timewritten = 0;
+    for(size_t s = 0; s < vcd->numseries; ++s)
+    {
+        int value = (int)_yvalue_as_double(y + s);
+        if(value == vcd->values[s])
+        {
+            continue;
+        }
+        if(!timewritten && (time > vcd->time))
+        {
+            vcd->time = time;
+            _vcd_time(vcd, time);
+        }
+        timewritten = 1;
+        vcd->values[s] = value;
+        _vcd_value(vcd, s, value);
+    }
+}
+
+static void destroy_vcd_writer(struct vcd_writer* vcd)
+{
+    free(vcd->values);
+    free(vcd->ids);
+    free(vcd);
+}
+
+static void _output_yvalue(struct output* output, const struct yvalue* y, int ydecimals)
+{
+    switch(y->type)
+    {
+        case REAL:
+            _output_fixed(output, y->d, ydecimals);
+            break;
+        case INTEGER:
+            _output_int(output, y->i);
+            break;
+        case STRING:
+            _output_string(output, y->str, strlen(y->str));
+            break;
+    }
+}
+
+static void _print_datum(struct output* output, const struct xydatum* datum, int xdecimals, int ydecimals, const char* print_separator)
+{
+    _output_fixed(output, datum->x, xdecimals);
+    _output_string(output, print_separator, strlen(print_separator));
+    _output_yvalue(output, &datum->y, ydecimals);
+    _output_string(output, "\n", 1);
+}
+
+// wide row: x followed by the y value of every series
+static void _print_row(struct output* output, const struct data* data, size_t i, int xdecimals, int ydecimals, const char* print_separator)
+{
+    size_t seplen = strlen(print_separator);
+    _output_fixed(output, data->x[i], xdecimals);
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        struct xydatum datum;
+        _get_datum(data, s, i, &datum);
+        _output_string(output, print_separator, seplen);
+        _output_yvalue(output, &datum.y, ydecimals);
+    }
+    _output_string(output, "\n", 1);
+}
+
+// parallel text output
+// the rows are cut into slices that are formatted by several threads into memory buffers, which
+// are then written in order with writev. The threads work in rounds of one slice each, so at
+// most numthreads slices are held in memory, the bytes are exactly those of the serial loop
+struct print_job {
+    const struct data* data;
+    size_t begin;
+    size_t end;
+    int xdecimals;
+    int ydecimals;
+    const char* print_separator;
+    struct output* buffer;
+};
+
+static void* _print_rows_worker(void* arg)
+{
+    struct print_job* job = arg;
+    job->buffer->length = 0;
+    for(size_t i = job->begin; i < job->end; ++i)
+    {
+        _print_row(job->buffer, job->data, i, job->xdecimals, job->ydecimals, job->print_separator);
+    }
+    return NULL;
+}
+
+// write the buffers of the jobs behind everything that is already in output
+static void _write_buffers(struct output* output, struct print_job* jobs, size_t numjobs)
+{
+    flush_output(output);
+    struct iovec* iov = malloc(sizeof(*iov) * numjobs);
+    for(size_t i = 0; i < numjobs; ++i)
+    {
+        iov[i].iov_base = jobs[i].buffer->buffer;
+        iov[i].iov_len = jobs[i].buffer->length;
+        output->written += jobs[i].buffer->length;
+    }
+    size_t first = 0;
+    while((first < numjobs) && !output->error)
+    {
+        int count = numjobs - first < IOV_MAX ? numjobs - first : IOV_MAX;
+        ssize_t ret = writev(output->fd, iov + first, count);
+        if(ret < 0)
+        {
+            if(errno != EINTR)
+            {
+                output->error = 1;
+            }
+            continue;
+        }
+        // skip what was written, the last buffer can be written partially
+        while((first < numjobs) && ((size_t)ret >= iov[first].iov_len))
+        {
+            ret -= iov[first].iov_len;
+            ++first;
+        }
+        if(first < numjobs)
+        {
+            iov[first].iov_base = (char*)iov[first].iov_base + ret;
+            iov[first].iov_len -= ret;
+        }
+    }
+    free(iov);
+}
+
+static void print_rows(struct output* output, const struct data* data, unsigned int numthreads, int xdecimals, int ydecimals, const char* print_separator)
+{
+    // small outputs are not worth the thread overhead
+    if((numthreads < 2) || (data->length < 2 * PRINT_SLICE_ROWS))
+    {
+        for(size_t i = 0; i < data->length; ++i)
+        {
+            _print_row(output, data, i, xdecimals, ydecimals, print_separator);
+        }
+        return;
+    }
+    struct print_job* jobs = malloc(sizeof(*jobs) * numthreads);
+    pthread_t* threads = malloc(sizeof(*threads) * numthreads);
+    for(unsigned int t = 0; t < numthreads; ++t)
+    {
+        jobs[t].data = data;
+        jobs[t].xdecimals = xdecimals;
+        jobs[t].ydecimals = ydecimals;
+        jobs[t].print_separator = print_separator;
+        jobs[t].buffer = create_output(-1);
+    }
+    for(size_t start = 0; start < data->length; start += (size_t)numthreads * PRINT_SLICE_ROWS)
+    {
+        unsigned int numjobs = 0;
+        for(unsigned int t = 0; t < numthreads; ++t)
+        {
+            size_t begin = start + (size_t)t * PRINT_SLICE_ROWS;
+            if(begin >= data->length)
+            {
+                break;
+            }
+            jobs[t].begin = begin;
+            jobs[t].end = begin + PRINT_SLICE_ROWS < data->length ? begin + PRINT_SLICE_ROWS : data->length;
+            ++numjobs;
+        }
+        // slices without a thread are formatted here
+        unsigned int started = 1;
+        while((started < numjobs) && (pthread_create(threads + started, NULL, _print_rows_worker, jobs + started) == 0))
+        {
+            ++started;
+        }
+        _print_rows_worker(jobs + 0);
+        for(unsigned int t = started; t < numjobs; ++t)
+        {
+            _print_rows_worker(jobs + t);
+        }
+        for(unsigned int t = 1; t < started; ++t)
+        {
+            pthread_join(threads[t], NULL);
+        }
+        _write_buffers(output, jobs, numjobs);
+    }
+    for(unsigned int t = 0; t < numthreads; ++t)
+    {
+        free(jobs[t].buffer->buffer);
+        free(jobs[t].buffer);
+    }
+    free(jobs);
+    free(threads);
+}
+
+// one output file per series, the first %d in the pattern is replaced by the y column index
+static struct output** open_series_outputs(const char* pattern, const unsigned int* yindices, size_t numseries)
+{
+    const char* placeholder = strstr(pattern, "%d");
+    size_t prefix = placeholder - pattern;
+    struct output** outputs = calloc(numseries, sizeof(*outputs));
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        char number[FORMAT_BUFFER_SIZE];
+        size_t numberlength = _format_uint(number, yindices[s]);
+        size_t length = strlen(pattern) - 2 + numberlength;
+        char* filename = malloc(length + 1);
+        memcpy(filename, pattern, prefix);
+        memcpy(filename + prefix, number, numberlength);
+        strcpy(filename + prefix + numberlength, placeholder + 2);
+        int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if(fd < 0)
+        {
+            fprintf(stderr, "filter_data: could not open output file '%s'\n", filename);
+            free(filename);
+            for(size_t i = 0; i < s; ++i)
+            {
+                close(outputs[i]->fd);
+                destroy_output(outputs[i]);
+            }
+            free(outputs);
+            return NULL;
+        }
+        free(filename);
+        outputs[s] = create_output(fd);
+    }
+    return outputs;
+}
+
+// returns 0 if any write failed
+static int close_series_outputs(struct output** outputs, size_t numseries)
+{
+    int ok = 1;
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        int fd = outputs[s]->fd;
+        ok = destroy_output(outputs[s]) && ok;
+        ok = (close(fd) == 0) && ok;
+    }
+    free(outputs);
+    return ok;
+}
+
+// streaming mode: sampling, redundant point removal and printing run directly on
+// every parsed block, the input is only held in memory one chunk at a time
+enum {
+    STEP_SAMPLE,
+    STEP_DIGITAL,
+    STEP_REDUNDANT,
+    STEP_COMPRESS,
+    NUM_STEPS
+};
+
+struct pipeline {
+    int sample;
+    struct sample_state sampler;
+    enum sample_mode samplemode;
+    struct resampler* resampler; // set for the interpolating sample modes
+    double* resampled; // y values of a row for the resampler
+    int remove_redundant;
+    struct redundancy_state* redundancy; // one per series
+    int compress;
+    double tolerance;
+    struct compress_state* compressors; // one per output
+    int digital;
+    double threshold;
+    double hysteresis;
+    struct digital_state* digitals; // one per series
+    struct vcd_writer* vcd; // replaces the text output of wide rows if set
+    void (*sink)(void* arg, double x, const struct yvalue* y); // takes wide rows instead of the outputs if set
+    void* sinkarg;
+    int xdecimals;
+    int ydecimals;
+    const char* print_separator;
+    struct output** outputs; // one per series or a single one for wide rows
+    size_t numoutputs;
+    size_t numseries;
+    size_t removed[NUM_STEPS]; // points removed by every step, for --stats
+    struct yvalue* rowy; // the row that runs through the steps
+    int* rowkeep;
+};
+
+static void _pipeline_resampled(void* arg, double x, const double* y);
+
+// allocate the per-file states, the settings have to be set already
+static void _init_pipeline_states(struct pipeline* pipeline, size_t numseries)
+{
+    pipeline->numseries = numseries;
+    memset(pipeline->removed, 0, sizeof(pipeline->removed));
+    pipeline->rowy = malloc(sizeof(*pipeline->rowy) * numseries);
+    pipeline->rowkeep = malloc(sizeof(*pipeline->rowkeep) * numseries);
+    pipeline->resampler = NULL;
+    pipeline->resampled = NULL;
+    if(pipeline->sample && (pipeline->samplemode != SAMPLE_FIRST))
+    {
+        pipeline->resampler = create_resampler(pipeline->samplemode, pipeline->sampler.start, pipeline->sampler.interval, numseries, _pipeline_resampled, pipeline);
+        pipeline->resampled = malloc(sizeof(*pipeline->resampled) * numseries);
+    }
+    pipeline->redundancy = malloc(sizeof(*pipeline->redundancy) * numseries);
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        _init_redundancy_state(pipeline->redundancy + s, pipeline->xdecimals, pipeline->ydecimals);
+    }
+    pipeline->digitals = NULL;
+    if(pipeline->digital)
+    {
+        pipeline->digitals = malloc(sizeof(*pipeline->digitals) * numseries);
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            _init_digital_state(pipeline->digitals + s, pipeline->threshold, pipeline->hysteresis);
+        }
+    }
+    pipeline->compressors = NULL;
+    if(pipeline->compress)
+    {
+        // wide rows are compressed jointly
+        size_t groupsize = pipeline->numoutputs == 1 ? numseries : 1;
+        pipeline->compressors = malloc(sizeof(*pipeline->compressors) * pipeline->numoutputs);
+        for(size_t i = 0; i < pipeline->numoutputs; ++i)
+        {
+            _init_compress_state(pipeline->compressors + i, pipeline->tolerance, groupsize);
+        }
+    }
+}
+
+static void _destroy_pipeline_states(struct pipeline* pipeline)
+{
+    free(pipeline->rowy);
+    free(pipeline->rowkeep);
+    if(pipeline->resampler)
+    {
+        destroy_resampler(pipeline->resampler);
+        free(pipeline->resampled);
+    }
+    free(pipeline->redundancy);
+    free(pipeline->digitals);
+    if(pipeline->compressors)
+    {
+        for(size_t i = 0; i < pipeline->numoutputs; ++i)
+        {
+            _destroy_compress_state(pipeline->compressors + i);
+        }
+        free(pipeline->compressors);
+    }
+}
+
+static void _print_values(struct output* output, double x, const struct yvalue* y, size_t numvalues, int xdecimals, int ydecimals, const char* print_separator)
+{
+    size_t seplen = strlen(print_separator);
+    _output_fixed(output, x, xdecimals);
+    for(size_t s = 0; s < numvalues; ++s)
+    {
+        _output_string(output, print_separator, seplen);
+        _output_yvalue(output, y + s, ydecimals);
+    }
+    _output_string(output, "\n", 1);
+}
+
+static void _emit_row(struct pipeline* pipeline, double x, const struct yvalue* y)
+{
+    if(pipeline->sink)
+    {
+        pipeline->sink(pipeline->sinkarg, x, y);
+    }
+    else if(pipeline->vcd)
+    {
+        vcd_row(pipeline->vcd, x, y);
+    }
+    else
+    {
+        _print_values(pipeline->outputs[0], x, y, pipeline->numseries, pipeline->xdecimals, pipeline->ydecimals, pipeline->print_separator);
+    }
+}
+
+static void _print_kept(struct pipeline* pipeline, size_t i, size_t numkept)
+{
+    const struct compress_state* state = pipeline->compressors + i;
+    // every point was counted as removed when it entered the compressor
+    pipeline->removed[STEP_COMPRESS] -= numkept * (pipeline->numoutputs == 1 ? pipeline->numseries : 1);
+    for(size_t k = 0; k < numkept; ++k)
+    {
+        if(pipeline->numoutputs == 1)
+        {
+            _emit_row(pipeline, state->kept[k].x, state->kept[k].y);
+        }
+        else
+        {
+            _print_values(pipeline->outputs[i], state->kept[k].x, state->kept[k].y, 1, pipeline->xdecimals, pipeline->ydecimals, pipeline->print_separator);
+        }
+    }
+}
+
+// digital, redundant point removal, compression and output of one row, keep tells whether
+// each series still has the point after the filters and sampling
+static void _pipeline_row(struct pipeline* pipeline, double x, const int* keep, size_t row)
+{
+    struct yvalue* y = pipeline->rowy;
+    int anykept = 0;
+    for(size_t s = 0; s < pipeline->numseries; ++s)
+    {
+        struct xydatum datum;
+        datum.x = x;
+        datum.y = y[s];
+        int kept = keep[s];
+        if(pipeline->digital)
+        {
+            int level = _digitize(pipeline->digitals + s, _yvalue_as_double(&datum.y));
+            datum.y.type = INTEGER;
+            datum.y.i = level;
+            if(kept && (level == pipeline->digitals[s].printed))
+            {
+                kept = 0;
+                ++pipeline->removed[STEP_DIGITAL];
+            }
+        }
+        y[s] = datum.y;
+        if(pipeline->remove_redundant && _is_redundant(pipeline->redundancy + s, &datum))
+        {
+            pipeline->removed[STEP_REDUNDANT] += kept;
+            kept = 0;
+        }
+        if(kept && (pipeline->numoutputs > 1))
+        {
+            if(pipeline->digital)
+            {
+                pipeline->digitals[s].printed = datum.y.i;
+            }
+            if(pipeline->compress)
+            {
+                ++pipeline->removed[STEP_COMPRESS];
+                _print_kept(pipeline, s, _compress_point(pipeline->compressors + s, datum.x, &datum.y, row));
+            }
+            else
+            {
+                _print_datum(pipeline->outputs[s], &datum, pipeline->xdecimals, pipeline->ydecimals, pipeline->print_separator);
+            }
+        }
+        anykept = anykept || kept;
+    }
+    if(anykept && (pipeline->numoutputs == 1))
+    {
+        if(pipeline->digital)
+        {
+            for(size_t s = 0; s < pipeline->numseries; ++s)
+            {
+                pipeline->digitals[s].printed = y[s].i;
+            }
+        }
+        if(pipeline->compress)
+        {
+            pipeline->removed[STEP_COMPRESS] += pipeline->numseries;
+            _print_kept(pipeline, 0, _compress_point(pipeline->compressors, x, y, row));
+        }
+        else
+        {
+            _emit_row(pipeline, x, y);
+        }
+    }
+}
+
+// grid points of the resampler run through the remaining steps like input rows
+static void _pipeline_resampled(void* arg, double x, const double* y)
+{
+    struct pipeline* pipeline = arg;
+    for(size_t s = 0; s < pipeline->numseries; ++s)
+    {
+        pipeline->rowy[s].type = REAL;
+        pipeline->rowy[s].d = y[s];
+        pipeline->rowkeep[s] = 1;
+    }
+    _pipeline_row(pipeline, x, pipeline->rowkeep, pipeline->resampler->numoutput);
+}
+
+static void _run_pipeline(struct pipeline* pipeline, const struct data* data)
+{
+    for(size_t i = 0; i < data->length; ++i)
+    {
+        if(pipeline->resampler)
+        {
+            int live = 0;
+            for(size_t s = 0; s < data->numseries; ++s)
+            {
+                const struct series* series = data->series + s;
+                pipeline->resampled[s] = series->yfloat ? series->y.f[i] : series->y.d[i];
+                live = live || !_is_deleted(series, i);
+            }
+            if(live)
+            {
+                resampler_push(pipeline->resampler, data->x[i], pipeline->resampled);
+            }
+            continue;
+        }
+        // every step has to see every point to keep its state up to date
+        int sampled = !pipeline->sample || _is_sampled(&pipeline->sampler, data->x[i]);
+        for(size_t s = 0; s < data->numseries; ++s)
+        {
+            struct xydatum datum;
+            _get_datum(data, s, i, &datum);
+            pipeline->rowy[s] = datum.y;
+            pipeline->rowkeep[s] = !_is_deleted(data->series + s, i);
+            if(pipeline->rowkeep[s] && !sampled)
+            {
+                pipeline->rowkeep[s] = 0;
+                ++pipeline->removed[STEP_SAMPLE];
+            }
+        }
+        _pipeline_row(pipeline, data->x[i], pipeline->rowkeep, i);
+    }
+}
+
+// print the points that are still held back at the end of the input
+static void _finish_pipeline(struct pipeline* pipeline)
+{
+    if(pipeline->resampler)
+    {
+        finish_resampler(pipeline->resampler);
+        // resampling can also add points
+        struct resampler* resampler = pipeline->resampler;
+        size_t removed = resampler->numinput > resampler->numoutput ? resampler->numinput - resampler->numoutput : 0;
+        pipeline->removed[STEP_SAMPLE] = removed * pipeline->numseries;
+    }
+    if(pipeline->compress)
+    {
+        for(size_t i = 0; i < pipeline->numoutputs; ++i)
+        {
+            _print_kept(pipeline, i, _finish_compress(pipeline->compressors + i));
+        }
+    }
+}
+
+
+static void _pipeline_chunk(struct data* data, void* arg)
+{
+    struct pipeline* pipeline = arg;
+    _run_pipeline(pipeline, data);
+    for(size_t i = 0; i < pipeline->numoutputs; ++i)
+    {
+        flush_output(pipeline->outputs[i]);
+    }
+}
+
+// follow is NULL unless --follow is given
+static int stream_data(const char* filename, size_t skip, unsigned int xindex, const unsigned int* yindices, size_t numseries, const char* separator, const struct filterplan* plan, enum ytype ytype, int multibit, struct pipeline* pipeline, struct follow* follow, struct stats* stats)
+{
+    struct source* source = follow ? open_follow_source(filename, follow) : open_source(filename);
+    if(!source)
+    {
+        return 0;
+    }
+    struct data* data = _create_data(1024, numseries, ytype, -1);
+    struct parse_job job = {
+        .xindex = xindex,
+        .yindices = yindices,
+        .numseries = numseries,
+        .separator = separator,
+        .plan = plan,
+        .ytype = ytype,
+        .multibit = multibit,
+        .dropped = stats ? stats->dropped : NULL,
+        .data = data,
+    };
+    int ok = _parse_source(source, skip, &job, _pipeline_chunk, pipeline, stats);
+    _finish_pipeline(pipeline);
+    for(size_t i = 0; i < pipeline->numoutputs; ++i)
+    {
+        flush_output(pipeline->outputs[i]);
+    }
+    _destroy_data(data);
+    return close_source(source) && ok;
+}
+
+// checkpoint of --follow
+// header (settings hash, file identity, reader position) followed by the sampling, redundancy and
+// digital states, written field by field as little-endian 64-bit values. The states only hold
+// plain values, --as-string and --tolerance (which holds points back) can't be checkpointed. The
+// file is replaced atomically, output that was written after the last checkpoint is written again
+// after a restart
+static int _write_u64(FILE* file, uint64_t value)
+{
+    unsigned char bytes[8];
+    for(size_t i = 0; i < sizeof(bytes); ++i)
+    {
+        bytes[i] = value >> (8 * i);
+    }
+    return fwrite(bytes, sizeof(bytes), 1, file) == 1;
+}
+
+static int _read_u64(FILE* file, uint64_t* value)
+{
+    unsigned char bytes[8];
+    if(fread(bytes, sizeof(bytes), 1, file) != 1)
+    {
+        return 0;
+    }
+    *value = 0;
+    for(size_t i = 0; i < sizeof(bytes); ++i)
+    {
+        *value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return 1;
+}
+
+static int _write_f64(FILE* file, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return _write_u64(file, bits);
+}
+
+static int _read_f64(FILE* file, double* value)
+{
+    uint64_t bits;
+    if(!_read_u64(file, &bits))
+    {
+        return 0;
+    }
+    memcpy(value, &bits, sizeof(bits));
+    return 1;
+}
+
+static int _read_int(FILE* file, int* value)
+{
+    uint64_t bits;
+    if(!_read_u64(file, &bits))
+    {
+        return 0;
+    }
+    *value = (int)(int64_t)bits;
+    return 1;
+}
+
+static uint64_t _hash_update(uint64_t hash, const void* data, size_t size)
+{
+    // FNV-1a, continued
+    const unsigned char* bytes = data;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t _hash_string_update(uint64_t hash, const char* str)
+{
+    // the terminator separates consecutive strings
+    return _hash_update(hash, str, strlen(str) + 1);
+}
+
+// hash of every setting that affects the output of --follow, a checkpoint is only resumed with
+// the same settings. The filters are taken from the command line in their order, they are
+// options with one argument except --y-is-integer and --no-fuse
+static uint64_t checkpoint_settings(int argc, char** argv, unsigned int xindex, const unsigned int* yindices, size_t numseries, const char* separator, size_t skip, enum ytype ytype, int multibit, const struct pipeline* pipeline)
+{
+    static const char* const filters[] = { "--xscale", "--yscale", "--xmin", "--xmax", "--xshift", "--yshift", "--every-nth" };
+    uint64_t hash = 0xcbf29ce484222325ull;
+    uint64_t values[] = {
+        xindex, numseries, skip, ytype, multibit,
+        pipeline->sample, pipeline->samplemode, pipeline->remove_redundant, pipeline->digital,
+        (uint64_t)(int64_t)pipeline->xdecimals, (uint64_t)(int64_t)pipeline->ydecimals,
+    };
+    hash = _hash_update(hash, values, sizeof(values));
+    for(size_t s = 0; s < numseries; ++s)
+    {
+        uint64_t index = yindices[s];
+        hash = _hash_update(hash, &index, sizeof(index));
+    }
+    hash = _hash_string_update(hash, separator);
+    hash = _hash_string_update(hash, pipeline->print_separator);
+    if(pipeline->sample)
+    {
+        hash = _hash_update(hash, &pipeline->sampler.start, sizeof(pipeline->sampler.start));
+        hash = _hash_update(hash, &pipeline->sampler.interval, sizeof(pipeline->sampler.interval));
+    }
+    if(pipeline->digital)
+    {
+        hash = _hash_update(hash, &pipeline->threshold, sizeof(pipeline->threshold));
+        hash = _hash_update(hash, &pipeline->hysteresis, sizeof(pipeline->hysteresis));
+    }
+    for(int i = 1; i < argc; ++i)
+    {
+        if((strcmp(argv[i], "--y-is-integer") == 0) || (strcmp(argv[i], "--no-fuse") == 0))
+        {
+            hash = _hash_string_update(hash, argv[i]);
+            continue;
+        }
+        for(size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+        {
+            if((strcmp(argv[i], filters[f]) == 0) && (i + 1 < argc))
+            {
+                hash = _hash_string_update(hash, argv[i]);
+                hash = _hash_string_update(hash, argv[i + 1]);
+                ++i;
+                break;
+            }
+        }
+    }
+    return hash;
+}
+
+static const char _checkpoint_magic[8] = { 'F', 'D', 'C', 'H', 'E', 'C', 'K', '2' };
+
+static void _save_checkpoint(const char* filename, const struct follow* follow)
+{
+    const struct pipeline* pipeline = follow->pipeline;
+    size_t length = strlen(filename);
+    char* tmpname = malloc(length + sizeof(CHECKPOINT_TMP_SUFFIX));
+    memcpy(tmpname, filename, length);
+    memcpy(tmpname + length, CHECKPOINT_TMP_SUFFIX, sizeof(CHECKPOINT_TMP_SUFFIX));
+    FILE* file = fopen(tmpname, "wb");
+    int ok = file &&
+        (fwrite(_checkpoint_magic, sizeof(_checkpoint_magic), 1, file) == 1) &&
+        _write_u64(file, follow->settings) &&
+        _write_u64(file, follow->filestat.st_dev) &&
+        _write_u64(file, follow->filestat.st_ino) &&
+        _write_u64(file, follow->offset) &&
+        _write_u64(file, follow->row) &&
+        _write_u64(file, follow->skipped) &&
+        _write_u64(file, pipeline->sampler.index);
+    // only the running state, the settings come from the command line
+    for(size_t s = 0; ok && (s < pipeline->numseries); ++s)
+    {
+        const struct redundancy_state* redundancy = pipeline->redundancy + s;
+        const struct yvalue* lasty = &redundancy->lasty;
+        // --as-string can't be checkpointed, integers are exact in a double
+        ok = _write_u64(file, redundancy->initialized) &&
+            _write_f64(file, redundancy->lastx) &&
+            _write_u64(file, lasty->type) &&
+            _write_f64(file, redundancy->initialized && (lasty->type == INTEGER) ? lasty->i : lasty->d);
+    }
+    for(size_t s = 0; ok && pipeline->digital && (s < pipeline->numseries); ++s)
+    {
+        ok = _write_u64(file, (uint64_t)(int64_t)pipeline->digitals[s].level) &&
+            _write_u64(file, (uint64_t)(int64_t)pipeline->digitals[s].printed);
+    }
+    if(file && (fclose(file) != 0))
+    {
+        ok = 0;
+    }
+    ok = ok && (rename(tmpname, filename) == 0);
+    if(!ok)
+    {
+        fprintf(stderr, "filter_data: could not write checkpoint '%s'\n", filename);
+        remove(tmpname);
+    }
+    free(tmpname);
+}
+
+// restore the reader position and the pipeline states (which have to be initialized already)
+// without a checkpoint file the input is processed from the beginning
+static int load_checkpoint(const char* filename, const char* inputname, struct follow* follow)
+{
+    FILE* file = fopen(filename, "rb");
+    if(!file)
+    {
+        if(errno == ENOENT)
+        {
+            return 1;
+        }
+        fprintf(stderr, "filter_data: could not open checkpoint '%s'\n", filename);
+        return 0;
+    }
+    struct pipeline* pipeline = follow->pipeline;
+    struct stat st;
+    char magic[sizeof(_checkpoint_magic)];
+    uint64_t settings;
+    uint64_t dev;
+    uint64_t ino;
+    int ok = (stat(inputname, &st) == 0) &&
+        (fread(magic, sizeof(magic), 1, file) == 1) &&
+        (memcmp(magic, _checkpoint_magic, sizeof(magic)) == 0) &&
+        _read_u64(file, &settings) &&
+        _read_u64(file, &dev) &&
+        _read_u64(file, &ino) &&
+        (settings == follow->settings) &&
+        (dev == (uint64_t)st.st_dev) &&
+        (ino == (uint64_t)st.st_ino);
+    if(!ok)
+    {
+        fprintf(stderr, "filter_data: checkpoint '%s' belongs to another file or other options\n", filename);
+        fclose(file);
+        return 0;
+    }
+    uint64_t offset;
+    uint64_t row;
+    uint64_t skipped;
+    uint64_t index;
+    ok = _read_u64(file, &offset) &&
+        _read_u64(file, &row) &&
+        _read_u64(file, &skipped) &&
+        _read_u64(file, &index);
+    pipeline->sampler.index = index;
+    for(size_t s = 0; ok && (s < pipeline->numseries); ++s)
+    {
+        struct redundancy_state* redundancy = pipeline->redundancy + s;
+        uint64_t initialized;
+        uint64_t type;
+        double lasty;
+        ok = _read_u64(file, &initialized) &&
+            _read_f64(file, &redundancy->lastx) &&
+            _read_u64(file, &type) &&
+            _read_f64(file, &lasty) &&
+            ((type == REAL) || (type == INTEGER));
+        redundancy->initialized = initialized != 0;
+        redundancy->lasty.type = type == INTEGER ? INTEGER : REAL;
+        if(redundancy->lasty.type == INTEGER)
+        {
+            redundancy->lasty.i = (int)lasty;
+        }
+        else
+        {
+            redundancy->lasty.d = lasty;
+        }
+    }
+    for(size_t s = 0; ok && pipeline->digital && (s < pipeline->numseries); ++s)
+    {
+        ok = _read_int(file, &pipeline->digitals[s].level) &&
+            _read_int(file, &pipeline->digitals[s].printed);
+    }
+    fclose(file);
+    if(!ok)
+    {
+        fprintf(stderr, "filter_data: checkpoint '%s' is truncated or invalid\n", filename);
+        return 0;
+    }
+    follow->offset = offset;
+    follow->row = row;
+    follow->skipped = skipped;
+    return 1;
+}
+
+// batch mode
+// many input/output pairs share one option set and filter plan. The files are streamed
+// concurrently by a fixed number of workers, so every worker only needs its own stream
+// and output buffer, independent of the file sizes
+struct batch_file {
+    char* input;
+    char* output;
+};
+
+struct batch {
+    const struct batch_file* files;
+    size_t numfiles;
+    size_t next;
+    size_t failed;
+    pthread_mutex_t mutex;
+    size_t skip;
+    unsigned int xindex;
+    const unsigned int* yindices;
+    size_t numseries;
+    const char* separator;
+    const struct filterplan* plan;
+    enum ytype ytype;
+    int multibit;
+    const struct pipeline* pipeline; // settings for every file, the states are reset per file
+};
+
+static char* _copy_token(const char* begin, const char* end)
+{
+    char* token = malloc(end - begin + 1);
+    memcpy(token, begin, end - begin);
+    token[end - begin] = 0;
+    return token;
+}
+
+static int _is_space(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+// every line of the manifest holds an input and an output filename, separated by whitespace
+// empty lines and lines starting with # are ignored
+static struct batch_file* read_manifest(const char* filename, size_t* numfiles)
+{
+    struct input* input = open_input(filename);
+    if(!input)
+    {
+        return NULL;
+    }
+    size_t capacity = 64;
+    size_t count = 0;
+    struct batch_file* files = malloc(sizeof(*files) * capacity);
+    const char* pos = input->data;
+    const char* end = input->data + input->size;
+    size_t line = 0;
+    while(pos < end)
+    {
+        const char* lineend = memchr(pos, '\n', end - pos);
+        if(!lineend)
+        {
+            lineend = end;
+        }
+        ++line;
+        const char* tokens[4];
+        size_t numtokens = 0;
+        const char* str = pos;
+        while(numtokens < 4)
+        {
+            while((str < lineend) && _is_space(*str))
+            {
+                ++str;
+            }
+            if((str == lineend) || ((numtokens == 0) && (*str == '#')))
+            {
+                break;
+            }
+            tokens[numtokens++] = str;
+            while((str < lineend) && !_is_space(*str))
+            {
+                ++str;
+            }
+            tokens[numtokens++] = str;
+        }
+        pos = lineend + 1;
+        if(numtokens == 0)
+        {
+            continue;
+        }
+        if(numtokens != 4)
+        {
+            fprintf(stderr, "filter_data: %s:%zu: expected an input and an output filename\n", filename, line);
+            for(size_t i = 0; i < count; ++i)
+            {
+                free(files[i].input);
+                free(files[i].output);
+            }
+            free(files);
+            close_input(input);
+            return NULL;
+        }
+        if(count == capacity)
+        {
+            capacity *= 2;
+            files = realloc(files, sizeof(*files) * capacity);
+        }
+        files[count].input = _copy_token(tokens[0], tokens[1]);
+        files[count].output = _copy_token(tokens[2], tokens[3]);
+        ++count;
+    }
+    close_input(input);
+    *numfiles = count;
+    return files;
+}
+
+static void destroy_manifest(struct batch_file* files, size_t numfiles)
+{
+    for(size_t i = 0; i < numfiles; ++i)
+    {
+        free(files[i].input);
+        free(files[i].output);
+    }
+    free(files);
+}
+
+static int _process_batch_file(struct batch* batch, const struct batch_file* file)
+{
+    int fd = open(file->output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+    {
+        fprintf(stderr, "filter_data: could not open output file '%s'\n", file->output);
+        return 0;
+    }
+    struct pipeline pipeline = *batch->pipeline;
+    struct output* output = create_output(fd);
+    pipeline.outputs = &output;
+    pipeline.numoutputs = 1;
+    _init_pipeline_states(&pipeline, batch->numseries);
+    int ok = stream_data(file->input, batch->skip, batch->xindex, batch->yindices, batch->numseries, batch->separator, batch->plan, batch->ytype, batch->multibit, &pipeline, NULL, NULL);
+    _destroy_pipeline_states(&pipeline);
+    if(!destroy_output(output) || (close(fd) != 0))
+    {
+        fprintf(stderr, "filter_data: could not write output file '%s'\n", file->output);
+        ok = 0;
+    }
+    return ok;
+}
+
+static void* _batch_worker(void* arg)
+{
+    struct batch* batch = arg;
+    while(1)
+    {
+        pthread_mutex_lock(&batch->mutex);
+        size_t i = batch->next;
+        if(i < batch->numfiles)
+        {
+            ++batch->next;
+        }
+        pthread_mutex_unlock(&batch->mutex);
+        if(i >= batch->numfiles)
+        {
+            break;
+        }
+        if(!_process_batch_file(batch, batch->files + i))
+        {
+            pthread_mutex_lock(&batch->mutex);
+            ++batch->failed;
+            pthread_mutex_unlock(&batch->mutex);
+        }
+    }
+    return NULL;
+}
+
+// returns the number of files that could not be processed
+static size_t run_batch(struct batch* batch, unsigned int numthreads)
+{
+    if(numthreads > batch->numfiles)
+    {
+        numthreads = batch->numfiles > 0 ? batch->numfiles : 1;
+    }
+    batch->next = 0;
+    batch->failed = 0;
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_t* threads = malloc(numthreads * sizeof(*threads));
+    unsigned int started = 0;
+    for(unsigned int i = 1; i < numthreads; ++i)
+    {
+        if(pthread_create(threads + i, NULL, _batch_worker, batch) != 0)
+        {
+            break;
+        }
+        ++started;
+    }
+    _batch_worker(batch);
+    for(unsigned int i = 1; i <= started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&batch->mutex);
+    return batch->failed;
+}
+
+// library interface (filterdata.h)
+// pushed points are cut into blocks for the filter plan and the filtered rows run through the
+// streaming pipeline, whose sink collects the kept rows for the callback
+#define PUSH_SLICE_SIZE (64 * BLOCK_SIZE)
+
+struct fd_context {
+    size_t numseries;
+    fd_callback callback;
+    void* userdata;
+    struct filterlist* filterlist;
+    struct filterplan* plan; // built on the first push
+    struct pipeline pipeline;
+    struct datablock* block;
+    struct seriesblock* seriesblock;
+    struct data* data; // filtered rows of the current slice
+    size_t row; // index of the next pushed point, used by --every-nth
+    double* x; // kept rows for the callback
+    double* y;
+    size_t length;
+    size_t capacity;
+    int started;
+    int finished;
+};
+
+static void _collect_row(void* arg, double x, const struct yvalue* y)
+{
+    struct fd_context* ctx = arg;
+    if(ctx->length == ctx->capacity)
+    {
+        ctx->capacity *= 2;
+        ctx->x = realloc(ctx->x, sizeof(*ctx->x) * ctx->capacity);
+        ctx->y = realloc(ctx->y, sizeof(*ctx->y) * ctx->capacity * ctx->numseries);
+    }
+    ctx->x[ctx->length] = x;
+    for(size_t s = 0; s < ctx->numseries; ++s)
+    {
+        ctx->y[ctx->length * ctx->numseries + s] = _yvalue_as_double(y + s);
+    }
+    ++ctx->length;
+}
+
+static void _deliver_rows(struct fd_context* ctx)
+{
+    if(ctx->length > 0)
+    {
+        ctx->callback(ctx->x, ctx->y, ctx->length, ctx->userdata);
+        ctx->length = 0;
+    }
+}
+
+FD_API struct fd_context* fd_create(size_t numseries, fd_callback callback, void* userdata)
+{
+    if((numseries < 1) || !callback)
+    {
+        return NULL;
+    }
+    struct fd_context* ctx = calloc(1, sizeof(*ctx));
+    ctx->numseries = numseries;
+    ctx->callback = callback;
+    ctx->userdata = userdata;
+    ctx->filterlist = create_filterlist();
+    ctx->pipeline.xdecimals = 16;
+    ctx->pipeline.ydecimals = 16;
+    ctx->pipeline.numoutputs = 1;
+    ctx->pipeline.sink = _collect_row;
+    ctx->pipeline.sinkarg = ctx;
+    ctx->capacity = 1024;
+    ctx->x = malloc(sizeof(*ctx->x) * ctx->capacity);
+    ctx->y = malloc(sizeof(*ctx->y) * ctx->capacity * numseries);
+    return ctx;
+}
+
+FD_API void fd_destroy(struct fd_context* ctx)
+{
+    if(!ctx)
+    {
+        return;
+    }
+    if(ctx->started)
+    {
+        _destroy_pipeline_states(&ctx->pipeline);
+        destroy_filterplan(ctx->plan);
+        free(ctx->block);
+        _destroy_seriesblock(ctx->seriesblock);
+        _destroy_data(ctx->data);
+    }
+    destroy_filterlist(ctx->filterlist);
+    free(ctx->x);
+    free(ctx->y);
+    free(ctx);
+}
+
+FD_API int fd_add_filter(struct fd_context* ctx, enum fd_filter filter, double arg)
+{
+    if(ctx->started)
+    {
+        return 0;
+    }
+    if(filter == FD_EVERY_NTH)
+    {
+        if(!(arg >= 1.0) || (arg > INT_MAX))
+        {
+            return 0;
+        }
+        int* nth = malloc(sizeof(*nth));
+        *nth = (int)arg;
+        _append_filter(ctx->filterlist, _create_filter_1_arg(_every_nth, nth));
+        return 1;
+    }
+    filter_func_1_arg func;
+    switch(filter)
+    {
+        case FD_XSCALE:
+            func = _scale_x;
+            break;
+        case FD_YSCALE:
+            func = _scale_y;
+            break;
+        case FD_XSHIFT:
+            func = _shift_x;
+            break;
+        case FD_YSHIFT:
+            func = _shift_y;
+            break;
+        case FD_XMIN:
+            func = _x_min;
+            break;
+        case FD_XMAX:
+            func = _x_max;
+            break;
+        default:
+            return 0;
+    }
+    double* value = malloc(sizeof(*value));
+    *value = arg;
+    _append_filter(ctx->filterlist, _create_filter_1_arg(func, value));
+    return 1;
+}
+
+FD_API int fd_set_sample(struct fd_context* ctx, double start, double interval)
+{
+    if(ctx->started || !(interval > 0.0))
+    {
+        return 0;
+    }
+    ctx->pipeline.sample = 1;
+    _init_sample_state(&ctx->pipeline.sampler, start, interval);
+    return 1;
+}
+
+FD_API int fd_set_sample_mode(struct fd_context* ctx, enum fd_sample_mode mode)
+{
+    if(ctx->started)
+    {
+        return 0;
+    }
+    switch(mode)
+    {
+        case FD_SAMPLE_FIRST:
+            ctx->pipeline.samplemode = SAMPLE_FIRST;
+            return 1;
+        case FD_SAMPLE_LINEAR:
+            ctx->pipeline.samplemode = SAMPLE_LINEAR;
+            return 1;
+        case FD_SAMPLE_CUBIC:
+            ctx->pipeline.samplemode = SAMPLE_CUBIC;
+            return 1;
+    }
+    return 0;
+}
+
+FD_API int fd_set_digital(struct fd_context* ctx, double threshold, double hysteresis)
+{
+    if(ctx->started || !(hysteresis >= 0.0))
+    {
+        return 0;
+    }
+    ctx->pipeline.digital = 1;
+    ctx->pipeline.threshold = threshold;
+    ctx->pipeline.hysteresis = hysteresis;
+    return 1;
+}
+
+FD_API int fd_set_remove_redundant(struct fd_context* ctx, int xdecimals, int ydecimals)
+{
+    if(ctx->started)
+    {
+        return 0;
+    }
+    ctx->pipeline.remove_redundant = 1;
+    ctx->pipeline.xdecimals = xdecimals;
+    ctx->pipeline.ydecimals = ydecimals;
+    return 1;
+}
+
+FD_API int fd_set_tolerance(struct fd_context* ctx, double tolerance)
+{
+    if(ctx->started || !(tolerance >= 0.0))
+    {
+        return 0;
+    }
+    ctx->pipeline.compress = 1;
+    ctx->pipeline.tolerance = tolerance;
+    return 1;
+}
+
+static void _start_context(struct fd_context* ctx)
+{
+    ctx->plan = plan_filters(ctx->filterlist, 1);
+    _init_pipeline_states(&ctx->pipeline, ctx->numseries);
+    ctx->block = malloc(sizeof(*ctx->block));
+    ctx->seriesblock = _create_seriesblock(ctx->numseries);
+    ctx->data = _create_data(PUSH_SLICE_SIZE, ctx->numseries, REAL, -1);
+    ctx->started = 1;
+}
+
+FD_API int fd_push(struct fd_context* ctx, const double* x, const double* y, size_t n)
+{
+    if(ctx->finished)
+    {
+        return 0;
+    }
+    if(!ctx->started)
+    {
+        _start_context(ctx);
+    }
+    struct datablock* block = ctx->block;
+    struct seriesblock* seriesblock = ctx->seriesblock;
+    size_t numseries = ctx->numseries;
+    // the pipeline runs on slices, so a large push does not need a copy of all its points
+    for(size_t slice = 0; slice < n; slice += PUSH_SLICE_SIZE)
+    {
+        size_t sliceend = n - slice < PUSH_SLICE_SIZE ? n : slice + PUSH_SLICE_SIZE;
+        _clear_data(ctx->data);
+        for(size_t first = slice; first < sliceend; first += BLOCK_SIZE)
+        {
+            size_t length = sliceend - first < BLOCK_SIZE ? sliceend - first : BLOCK_SIZE;
+            block->length = length;
+            block->firstrow = ctx->row + first;
+            memcpy(block->x, x + first, sizeof(*block->x) * length);
+            memset(block->keep, 1, length);
+            if(seriesblock)
+            {
+                for(size_t s = 0; s < numseries; ++s)
+                {
+                    double* column = seriesblock->y + s * BLOCK_SIZE;
+                    for(size_t i = 0; i < length; ++i)
+                    {
+                        column[i] = y[(first + i) * numseries + s];
+                    }
+                }
+            }
+            else
+            {
+                memcpy(block->y, y + first, sizeof(*block->y) * length);
+            }
+            _filter_rows(block, seriesblock, ctx->plan, NULL, ctx->data);
+        }
+        _run_pipeline(&ctx->pipeline, ctx->data);
+    }
+    ctx->row += n;
+    _deliver_rows(ctx);
+    return 1;
+}
+
+FD_API int fd_finish(struct fd_context* ctx)
+{
+    if(ctx->finished)
+    {
+        return 0;
+    }
+    if(ctx->started)
+    {
+        _finish_pipeline(&ctx->pipeline);
+        _deliver_rows(ctx);
+    }
+    ctx->finished = 1;
+    return 1;
+}
+
+// statistics report
+static struct stats* create_stats(const struct filterplan* plan)
+{
+    struct stats* stats = calloc(1, sizeof(*stats));
+    stats->dropped = calloc(plan->size > 0 ? plan->size : 1, sizeof(*stats->dropped));
+    stats->wallbegin = _clock_seconds(CLOCK_MONOTONIC);
+    stats->cpubegin = _clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    return stats;
+}
+
+static void destroy_stats(struct stats* stats)
+{
+    if(stats)
+    {
+        free(stats->dropped);
+        free(stats);
+    }
+}
+
+static size_t _dropped_points(const struct stats* stats, const struct filterplan* plan)
+{
+    size_t dropped = 0;
+    for(size_t i = 0; i < plan->size; ++i)
     {
-        if(_arg_is(argv[i], "-S", "--print-separator"))
-        {
-            if(i < argc - 1)
-            {
-                return strdup(argv[i + 1]);
-            }
-        }
+        dropped += stats->dropped[i];
     }
-    return strdup(default_sep);
+    return dropped;
 }
 
-static int _is_equal(double x1, double x2, double precision)
+static size_t _live_points(const struct data* data)
 {
-    return fabs(x1 - x2) < precision;
+    size_t live = 0;
+    for(size_t s = 0; s < data->numseries; ++s)
+    {
+        live += _count_live(data->series + s, data->length);
+    }
+    return live;
 }
 
-static void _remove_redundant_points(struct data* data, int xdecimals, int ydecimals)
+// live points before a post-processing step, 0 without --stats
+static size_t _begin_step(struct stats* stats, const struct data* data)
 {
-    // x-filter
-    double xprecision = pow(10, -xdecimals);
-    // find redundant points and mark the as deleted
-    struct xydatum* lastdatum = data->data + 0;
-    for(size_t i = 1; i < data->length; ++i)
+    if(!stats)
     {
-        struct xydatum* datum = data->data + i;
-        if(_is_equal(datum->x, lastdatum->x, xprecision))
-        {
-            datum->deleted = 1;
-        }
-        else
-        {
-            lastdatum = datum;
-        }
+        return 0;
     }
+    size_t live = _live_points(data);
+    _stats_start(stats);
+    return live;
+}
 
-    // y-filter
-    double yprecision = pow(10, -ydecimals);
-    // find redundant points and mark the as deleted
-    lastdatum = data->data + 0;
-    for(size_t i = 1; i < data->length; ++i)
+static void _end_step(struct stats* stats, const char* name, const struct data* data, size_t live)
+{
+    if(stats)
     {
-        struct xydatum* datum = data->data + i;
-        int advance = 1;
-        switch(lastdatum->y.type)
-        {
-            case REAL:
-                advance = !_is_equal(datum->y.d, lastdatum->y.d, yprecision);
-                break;
-            case INTEGER:
-                advance = !(datum->y.i == lastdatum->y.i);
-                break;
-            case STRING:
-                advance = (strcmp(datum->y.str, lastdatum->y.str) != 0);
-                break;
-        }
-        if(advance)
-        {
-            lastdatum = datum;
-        }
-        else
-        {
-            datum->deleted = 1;
-        }
+        _stats_stop(stats, name, 0);
+        // resampling can also add points
+        size_t after = _live_points(data);
+        stats->stages[stats->numstages - 1].removed = live > after ? live - after : 0;
     }
 }
 
-static void _sample_data(struct data* data, double samplestart, double sampleinterval)
+static void print_stats(const struct stats* stats, const struct filterplan* plan, int json)
 {
-    // FIXME: assumes monotone data, implement check?
-    size_t sampleindex = 0;
-    for(size_t i = 0; i < data->length; ++i)
+    double wall = _clock_seconds(CLOCK_MONOTONIC) - stats->wallbegin;
+    double cpu = _clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - stats->cpubegin;
+    struct rusage usage;
+    long peakrss = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0; // kB on linux
+    if(json)
     {
-        struct xydatum* datum = data->data + i;
-        if(datum->x < samplestart)
+        fprintf(stderr, "{\"bytes_read\":%zu,\"rows_parsed\":%zu,\"rows_kept\":%zu,\"filters\":[", stats->bytesread, stats->rowsparsed, stats->rowskept);
+        for(size_t i = 0; i < plan->size; ++i)
         {
-            datum->deleted = 1;
+            fprintf(stderr, "%s{\"options\":\"%s\",\"dropped\":%zu}", i > 0 ? "," : "", plan->stages[i].label, stats->dropped[i]);
         }
-        else
+        fputs("],\"stages\":[", stderr);
+        for(size_t i = 0; i < stats->numstages; ++i)
         {
-            size_t index = (datum->x - samplestart) / sampleinterval;
-            if(index > sampleindex)
+            const struct stats_stage* stage = stats->stages + i;
+            fprintf(stderr, "%s{\"name\":\"%s\",", i > 0 ? "," : "", stage->name);
+            if(stage->wall >= 0.0)
             {
-                sampleindex = index;
+                fprintf(stderr, "\"wall\":%.6f,\"cpu\":%.6f,", stage->wall, stage->cpu);
             }
             else
             {
-                datum->deleted = 1;
+                fputs("\"wall\":null,\"cpu\":null,", stderr);
             }
+            fprintf(stderr, "\"removed\":%zu}", stage->removed);
+        }
+        fprintf(stderr, "],\"wall\":%.6f,\"cpu\":%.6f,\"output_bytes\":%zu,\"peak_rss_kb\":%ld}\n", wall, cpu, stats->outputbytes, peakrss);
+        return;
+    }
+    fprintf(stderr, "filter_data: %zu bytes read, %zu rows parsed, %zu rows kept by the filters\n", stats->bytesread, stats->rowsparsed, stats->rowskept);
+    for(size_t i = 0; i < plan->size; ++i)
+    {
+        fprintf(stderr, "  filter %-40s %12zu points dropped\n", plan->stages[i].label, stats->dropped[i]);
+    }
+    fprintf(stderr, "  %-16s %12s %12s %14s\n", "stage", "wall/ms", "cpu/ms", "points removed");
+    for(size_t i = 0; i < stats->numstages; ++i)
+    {
+        const struct stats_stage* stage = stats->stages + i;
+        if(stage->wall >= 0.0)
+        {
+            fprintf(stderr, "  %-16s %12.3f %12.3f %14zu\n", stage->name, stage->wall * 1e3, stage->cpu * 1e3, stage->removed);
+        }
+        else
+        {
+            fprintf(stderr, "  %-16s %12s %12s %14zu\n", stage->name, "-", "-", stage->removed);
         }
     }
+    fprintf(stderr, "  %-16s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+    fprintf(stderr, "  %zu bytes written, peak rss %ld kB\n", stats->outputbytes, peakrss);
 }
 
+#ifndef FD_LIBRARY
 int main(int argc, char** argv)
 {
+    _init_number_parser();
+    _init_field_scanner();
     if((argc == 2) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
     {
         _usage();
         return 0;
     }
+    // --batch <manifest> takes the place of the filename
+    int batchmode = (argc > 1) && (strcmp(argv[1], "--batch") == 0);
+    if(batchmode)
+    {
+        --argc;
+        ++argv;
+    }
     if(argc < 2)
     {
         fputs("filter_data: no filename given\n", stderr);
@@ -601,13 +7264,36 @@ int main(int argc, char** argv)
         return 1;
     }
     const char* filename = argv[1];
-    unsigned int xindex = atoi(argv[2]);
-    unsigned int yindex = atoi(argv[3]);
+    unsigned int xindex = 0;
+    size_t numseries = 0;
+    unsigned int* yindices = NULL;
+    if(_is_column_list(argv[2]) && _is_column_list(argv[3]))
+    {
+        xindex = atoi(argv[2]);
+        yindices = _parse_columns(argv[3], &numseries);
+    }
+    else if(batchmode)
+    {
+        fputs("filter_data: variable names can't be used in batch mode\n", stderr);
+    }
+    else
+    {
+        resolve_spice_names(filename, argv[2], argv[3], &xindex, &yindices, &numseries);
+    }
+    if(!yindices)
+    {
+        return 1;
+    }
 
     struct filterlist* filterlist = create_filterlist();
 
     char* separator = _get_separator(argc, argv, ",");
     char* print_separator = _get_print_separator(argc, argv, " ");
+    if(!*separator)
+    {
+        fputs("filter_data: separator must not be empty\n", stderr);
+        return 1;
+    }
 
     int i = 4;
     while(i < argc)
@@ -704,8 +7390,12 @@ int main(int argc, char** argv)
             }
             int* arg = malloc(sizeof(*arg));
             *arg = atoi(argv[i + 1]);
-            int* count = malloc(sizeof(*arg));
-            *count = 0;
+            if(*arg < 1)
+            {
+                fprintf(stderr, "%s\n", "--every-nth: argument must be positive");
+                free(arg);
+                return 1;
+            }
             struct filter* filter = _create_filter_1_arg(_every_nth, arg);
             _append_filter(filterlist, filter);
             ++i;
@@ -722,10 +7412,369 @@ int main(int argc, char** argv)
 
     int xdecimals = _get_xdecimals(argc, argv);
     int ydecimals = _get_ydecimals(argc, argv);
+    size_t skip = _get_skiplines(argc, argv);
+    // bus values are decoded to integers
+    int multibit = _has_arg(argc, argv, NULL, "--y-is-multibit");
+    enum ytype ytype = REAL;
+    if(_has_arg(argc, argv, NULL, "--y-is-integer") || multibit)
+    {
+        ytype = INTEGER;
+    }
+    else if(_has_arg(argc, argv, NULL, "--as-string"))
+    {
+        ytype = STRING;
+    }
+
+    struct filterplan* plan = plan_filters(filterlist, !_has_arg(argc, argv, NULL, "--no-fuse"));
+    const char* output_format = _get_output_format(argc, argv);
+    int binary_output = strcmp(output_format, "bin") == 0;
+    int vcd_output = strcmp(output_format, "vcd") == 0;
+    if(!binary_output && !vcd_output && (strcmp(output_format, "text") != 0))
+    {
+        fprintf(stderr, "filter_data: unknown output format '%s'\n", output_format);
+        return 1;
+    }
+    const char* output_pattern = _get_output_pattern(argc, argv);
+    if(output_pattern && !strstr(output_pattern, "%d"))
+    {
+        fputs("filter_data: --output-pattern needs a %d for the y column index\n", stderr);
+        return 1;
+    }
+    if(output_pattern && vcd_output)
+    {
+        fputs("filter_data: vcd output writes all series into one file, it can't be combined with --output-pattern\n", stderr);
+        return 1;
+    }
+    if(ytype == STRING)
+    {
+        // the parser passes symbol numbers through the filters
+        static const char* const numerical[] = { "--yscale", "--yshift", "--y-is-integer", "--y-float32", "--digital", "--tolerance", "--reduce" };
+        for(size_t j = 0; j < sizeof(numerical) / sizeof(numerical[0]); ++j)
+        {
+            if(_has_arg(argc, argv, NULL, numerical[j]))
+            {
+                fprintf(stderr, "filter_data: %s can't be used with --as-string\n", numerical[j]);
+                return 1;
+            }
+        }
+        if(binary_output || vcd_output)
+        {
+            fputs("filter_data: string data can only be written as text\n", stderr);
+            return 1;
+        }
+    }
+    int showstats = _has_arg(argc, argv, NULL, "--stats") || _has_arg(argc, argv, NULL, "--stats-format");
+    const char* stats_format = _get_stats_format(argc, argv);
+    int stats_json = strcmp(stats_format, "json") == 0;
+    if(!stats_json && (strcmp(stats_format, "text") != 0))
+    {
+        fprintf(stderr, "filter_data: unknown stats format '%s'\n", stats_format);
+        return 1;
+    }
+    // vcd output is always digital
+    int digital = _has_arg(argc, argv, NULL, "--digital") || vcd_output;
+    double threshold = _get_threshold(argc, argv);
+    double hysteresis = _get_hysteresis(argc, argv);
+    if(output_pattern && binary_output)
+    {
+        fputs("filter_data: binary output writes all series into one file, it can't be combined with --output-pattern\n", stderr);
+        return 1;
+    }
+
+    double tolerance = _get_tolerance(argc, argv);
+    int compress = _has_arg(argc, argv, NULL, "--tolerance");
+    if(compress && !(tolerance >= 0.0))
+    {
+        fputs("filter_data: --tolerance: argument must not be negative\n", stderr);
+        return 1;
+    }
+    size_t reduce = _get_reduce(argc, argv);
+    enum reduce_mode reduce_mode = REDUCE_LTTB;
+    if(reduce > 0)
+    {
+        const char* mode = _get_reduce_mode(argc, argv);
+        if(strcmp(mode, "minmax") == 0)
+        {
+            reduce_mode = REDUCE_MINMAX;
+        }
+        else if(strcmp(mode, "lttb") != 0)
+        {
+            fprintf(stderr, "filter_data: unknown reduce mode '%s'\n", mode);
+            return 1;
+        }
+        if(reduce < 4)
+        {
+            fputs("filter_data: --reduce: argument must be at least 4\n", stderr);
+            return 1;
+        }
+        // the bucket size depends on the total number of points
+        if(batchmode || _has_arg(argc, argv, NULL, "--stream") || _has_arg(argc, argv, NULL, "--follow") || (strcmp(filename, "-") == 0))
+        {
+            fputs("filter_data: --reduce needs the complete data, it can't be combined with streaming or batch mode\n", stderr);
+            return 1;
+        }
+    }
+
+    enum sample_mode samplemode;
+    if(!_get_sample_mode(argc, argv, &samplemode))
+    {
+        return 1;
+    }
+    int resample = _has_arg(argc, argv, NULL, "--sample") && (samplemode != SAMPLE_FIRST);
+    if(resample)
+    {
+        if(!(_get_sample_interval(argc, argv) > 0.0))
+        {
+            fputs("filter_data: --sample-interval must be positive for interpolation\n", stderr);
+            return 1;
+        }
+        if(ytype != REAL)
+        {
+            fputs("filter_data: --sample-mode linear and cubic interpolate real y values, they can't be combined with --y-is-integer, --y-is-multibit or --as-string\n", stderr);
+            return 1;
+        }
+    }
+
+    int follow = _has_arg(argc, argv, NULL, "--follow");
+    const char* checkpoint = _get_checkpoint(argc, argv);
+    if(follow && (batchmode || (strcmp(filename, "-") == 0)))
+    {
+        fputs("filter_data: --follow needs a single input file\n", stderr);
+        return 1;
+    }
+    if(checkpoint)
+    {
+        if(!follow)
+        {
+            fputs("filter_data: --checkpoint only works with --follow\n", stderr);
+            return 1;
+        }
+        // the checkpoint only holds plain values and the output has to continue seamlessly
+        if(compress || resample || (ytype == STRING) || vcd_output || output_pattern)
+        {
+            fputs("filter_data: --checkpoint can't be combined with --tolerance, --sample-mode linear or cubic, --as-string, vcd output or --output-pattern\n", stderr);
+            return 1;
+        }
+    }
+
+    if(batchmode)
+    {
+        if(showstats)
+        {
+            fputs("filter_data: --stats can't be combined with batch mode\n", stderr);
+            return 1;
+        }
+        if(binary_output || vcd_output || output_pattern)
+        {
+            fputs("filter_data: batch mode writes text output to the files given in the manifest\n", stderr);
+            return 1;
+        }
+        size_t numfiles;
+        struct batch_file* files = read_manifest(filename, &numfiles);
+        if(!files)
+        {
+            return 1;
+        }
+        struct pipeline pipeline;
+        pipeline.sample = _has_arg(argc, argv, NULL, "--sample");
+        _init_sample_state(&pipeline.sampler, _get_sample_start(argc, argv), _get_sample_interval(argc, argv));
+        pipeline.samplemode = samplemode;
+        pipeline.remove_redundant = _has_arg(argc, argv, "-r", "--remove-redundant-points");
+        pipeline.compress = compress;
+        pipeline.tolerance = tolerance;
+        pipeline.digital = digital;
+        pipeline.threshold = threshold;
+        pipeline.hysteresis = hysteresis;
+        pipeline.vcd = NULL;
+        pipeline.sink = NULL;
+        pipeline.xdecimals = xdecimals;
+        pipeline.ydecimals = ydecimals;
+        pipeline.print_separator = print_separator;
+        struct batch batch = {
+            .files = files,
+            .numfiles = numfiles,
+            .skip = skip,
+            .xindex = xindex,
+            .yindices = yindices,
+            .numseries = numseries,
+            .separator = separator,
+            .plan = plan,
+            .ytype = ytype,
+            .multibit = multibit,
+            .pipeline = &pipeline,
+        };
+        // without -j every core gets a worker
+        long numcpus = sysconf(_SC_NPROCESSORS_ONLN);
+        unsigned int numthreads = _has_arg(argc, argv, "-j", "--threads") || (numcpus < 1) ? _get_threads(argc, argv) : numcpus;
+        size_t failed = run_batch(&batch, numthreads);
+        if(failed > 0)
+        {
+            fprintf(stderr, "filter_data: %zu of %zu files failed\n", failed, numfiles);
+        }
+        destroy_manifest(files, numfiles);
+        free(yindices);
+        free(separator);
+        free(print_separator);
+        destroy_filterplan(plan);
+        destroy_filterlist(filterlist);
+        return failed > 0 ? 1 : 0;
+    }
+
+    // standard input is always streamed
+    if(_has_arg(argc, argv, NULL, "--stream") || follow || (strcmp(filename, "-") == 0))
+    {
+        if(binary_output)
+        {
+            fputs("filter_data: binary output needs the complete data, it can't be combined with streaming\n", stderr);
+            return 1;
+        }
+        if((strcmp(filename, "-") != 0) && _is_spice_raw_file(filename))
+        {
+            fputs("filter_data: SPICE raw files can't be streamed, they are read without parsing anyway\n", stderr);
+            return 1;
+        }
+        struct pipeline pipeline;
+        pipeline.sample = _has_arg(argc, argv, NULL, "--sample");
+        _init_sample_state(&pipeline.sampler, _get_sample_start(argc, argv), _get_sample_interval(argc, argv));
+        pipeline.samplemode = samplemode;
+        pipeline.remove_redundant = _has_arg(argc, argv, "-r", "--remove-redundant-points");
+        pipeline.compress = compress;
+        pipeline.tolerance = tolerance;
+        pipeline.digital = digital;
+        pipeline.threshold = threshold;
+        pipeline.hysteresis = hysteresis;
+        pipeline.vcd = NULL;
+        pipeline.sink = NULL;
+        pipeline.xdecimals = xdecimals;
+        pipeline.ydecimals = ydecimals;
+        pipeline.print_separator = print_separator;
+        if(output_pattern)
+        {
+            pipeline.outputs = open_series_outputs(output_pattern, yindices, numseries);
+            if(!pipeline.outputs)
+            {
+                return 1;
+            }
+            pipeline.numoutputs = numseries;
+        }
+        else
+        {
+            pipeline.outputs = malloc(sizeof(*pipeline.outputs));
+            pipeline.outputs[0] = create_output(STDOUT_FILENO);
+            pipeline.numoutputs = 1;
+        }
+        _init_pipeline_states(&pipeline, numseries);
+        if(vcd_output)
+        {
+            pipeline.vcd = create_vcd_writer(pipeline.outputs[0], _get_vcd_timescale(argc, argv), yindices, numseries);
+            if(!pipeline.vcd)
+            {
+                return 1;
+            }
+        }
+        struct follow following = {
+            .inotify = -1,
+            .timeout = _get_follow_timeout(argc, argv),
+            .skip = skip,
+            .checkpoint = checkpoint,
+            .pipeline = &pipeline,
+            .settings = checkpoint_settings(argc, argv, xindex, yindices, numseries, separator, skip, ytype, multibit, &pipeline),
+        };
+        if(follow)
+        {
+            if(checkpoint && !load_checkpoint(checkpoint, filename, &following))
+            {
+                return 1;
+            }
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = _stop_following;
+            sigaction(SIGINT, &action, NULL);
+            sigaction(SIGTERM, &action, NULL);
+        }
+        struct stats* stats = showstats ? create_stats(plan) : NULL;
+        _stats_start(stats);
+        int ok = stream_data(filename, skip, xindex, yindices, numseries, separator, plan, ytype, multibit, &pipeline, follow ? &following : NULL, stats);
+        if(stats)
+        {
+            // the steps run interleaved, only the whole pass is timed
+            _stats_stop(stats, "stream", _dropped_points(stats, plan));
+            if(pipeline.sample)
+            {
+                _stats_count(stats, "sample", pipeline.removed[STEP_SAMPLE]);
+            }
+            if(digital)
+            {
+                _stats_count(stats, "digital", pipeline.removed[STEP_DIGITAL]);
+            }
+            if(pipeline.remove_redundant)
+            {
+                _stats_count(stats, "redundant", pipeline.removed[STEP_REDUNDANT]);
+            }
+            if(compress)
+            {
+                _stats_count(stats, "compress", pipeline.removed[STEP_COMPRESS]);
+            }
+            stats->outputbytes = _output_bytes(pipeline.outputs, pipeline.numoutputs);
+        }
+        if(output_pattern)
+        {
+            ok = close_series_outputs(pipeline.outputs, numseries) && ok;
+        }
+        else
+        {
+            if(!destroy_output(pipeline.outputs[0]))
+            {
+                fputs("filter_data: could not write output\n", stderr);
+                ok = 0;
+            }
+            free(pipeline.outputs);
+        }
+        if(pipeline.vcd)
+        {
+            destroy_vcd_writer(pipeline.vcd);
+        }
+        _destroy_pipeline_states(&pipeline);
+        if(stats)
+        {
+            print_stats(stats, plan, stats_json);
+            destroy_stats(stats);
+        }
+        free(yindices);
+        free(separator);
+        free(print_separator);
+        destroy_filterplan(plan);
+        destroy_filterlist(filterlist);
+        return ok ? 0 : 1;
+    }
 
     // read data
-    size_t skip = _get_skiplines(argc, argv);
-    struct data* data = read_data(filename, skip, xindex, yindex, separator, filterlist);
+    unsigned int numthreads = _get_threads(argc, argv);
+    // single precision only keeps the printed digits, steps that compare or combine y values
+    // would see the rounding, so they get double precision
+    int yfloatcompute = _has_arg(argc, argv, "-r", "--remove-redundant-points") || compress || digital || (reduce > 0) || resample;
+    int yfloatdecimals = _has_arg(argc, argv, NULL, "--y-float32") && !yfloatcompute ? ydecimals : -1;
+    size_t indexstride = 0;
+    if(_has_arg(argc, argv, NULL, "--build-index"))
+    {
+        indexstride = _get_index_stride(argc, argv);
+    }
+    enum complex_part complexpart;
+    if(!_get_complex_part(argc, argv, &complexpart))
+    {
+        return 1;
+    }
+    struct stats* stats = showstats ? create_stats(plan) : NULL;
+    _stats_start(stats);
+    struct data* data = read_data(filename, skip, xindex, yindices, numseries, separator, plan, ytype, multibit, yfloatdecimals, numthreads, indexstride, complexpart, stats);
+    if(!data)
+    {
+        return 1;
+    }
+    if(stats)
+    {
+        _stats_stop(stats, "read", _dropped_points(stats, plan));
+    }
     // FIXME: move filter out of data read-in? efficiency?
 
     // sample data
@@ -733,39 +7782,136 @@ int main(int argc, char** argv)
     {
         double samplestart = _get_sample_start(argc, argv);
         double sampleinterval = _get_sample_interval(argc, argv);
-        _sample_data(data, samplestart, sampleinterval);
+        size_t live = _begin_step(stats, data);
+        if(samplemode == SAMPLE_FIRST)
+        {
+            _sample_data(data, samplestart, sampleinterval);
+        }
+        else
+        {
+            _resample_data(data, samplemode, samplestart, sampleinterval);
+        }
+        _end_step(stats, "sample", data, live);
+    }
+
+    // logic levels, only edges are kept
+    if(digital)
+    {
+        size_t live = _begin_step(stats, data);
+        _digitize_data(data, threshold, hysteresis, _has_arg(argc, argv, "-r", "--remove-redundant-points"), xdecimals, ydecimals, !output_pattern);
+        _end_step(stats, "digital", data, live);
     }
 
     // post-process data
     if(_has_arg(argc, argv, "-r", "--remove-redundant-points"))
     {
+        size_t live = _begin_step(stats, data);
         _remove_redundant_points(data, xdecimals, ydecimals);
+        _end_step(stats, "redundant", data, live);
+    }
+
+    // piecewise-linear compression
+    if(compress)
+    {
+        size_t live = _begin_step(stats, data);
+        _compress_data(data, tolerance, !output_pattern);
+        _end_step(stats, "compress", data, live);
+    }
+
+    // decimate
+    if(reduce > 0)
+    {
+        size_t live = _begin_step(stats, data);
+        _reduce_data(data, reduce, reduce_mode);
+        _end_step(stats, "reduce", data, live);
     }
 
+    _stats_start(stats);
+    _compact_data(data);
+    _stats_stop(stats, "compact", 0);
+
     // print data
-    for(size_t i = 0; i < data->length; ++i)
+    _stats_start(stats);
+    int ok = 1;
+    if(output_pattern)
+    {
+        struct output** outputs = open_series_outputs(output_pattern, yindices, numseries);
+        if(!outputs)
+        {
+            return 1;
+        }
+        for(size_t s = 0; s < numseries; ++s)
+        {
+            for(size_t i = 0; i < data->length; ++i)
+            {
+                if(!_is_deleted(data->series + s, i))
+                {
+                    struct xydatum datum;
+                    _get_datum(data, s, i, &datum);
+                    _print_datum(outputs[s], &datum, xdecimals, ydecimals, print_separator);
+                }
+            }
+        }
+        if(stats)
+        {
+            stats->outputbytes = _output_bytes(outputs, numseries);
+        }
+        ok = close_series_outputs(outputs, numseries);
+    }
+    else
     {
-        if(!(data->data + i)->deleted)
+        struct output* output = create_output(STDOUT_FILENO);
+        if(binary_output)
+        {
+            ok = write_binary(output, data);
+        }
+        else if(vcd_output)
         {
-            switch((data->data + i)->y.type)
+            struct vcd_writer* vcd = create_vcd_writer(output, _get_vcd_timescale(argc, argv), yindices, numseries);
+            ok = vcd != NULL;
+            if(vcd)
             {
-                case REAL:
-                    printf("%.*f%s%.*f\n", xdecimals, (data->data + i)->x, print_separator, ydecimals, (data->data + i)->y.d);
-                    break;
-                case INTEGER:
-                    printf("%.*f%s%d\n", xdecimals, (data->data + i)->x, print_separator, (data->data + i)->y.i);
-                    break;
-                case STRING:
-                    printf("%.*f%s%s\n", xdecimals, (data->data + i)->x, print_separator, (data->data + i)->y.str);
-                    break;
+                struct yvalue* y = malloc(sizeof(*y) * numseries);
+                for(size_t i = 0; i < data->length; ++i)
+                {
+                    for(size_t s = 0; s < numseries; ++s)
+                    {
+                        struct xydatum datum;
+                        _get_datum(data, s, i, &datum);
+                        y[s] = datum.y;
+                    }
+                    vcd_row(vcd, data->x[i], y);
+                }
+                free(y);
+                destroy_vcd_writer(vcd);
             }
         }
+        else
+        {
+            print_rows(output, data, numthreads, xdecimals, ydecimals, print_separator);
+        }
+        if(stats)
+        {
+            stats->outputbytes = _output_bytes(&output, 1);
+        }
+        if(!destroy_output(output))
+        {
+            fputs("filter_data: could not write output\n", stderr);
+            ok = 0;
+        }
     }
-    free(data->data);
-    free(data);
+    _stats_stop(stats, "print", 0);
+    if(stats)
+    {
+        print_stats(stats, plan, stats_json);
+        destroy_stats(stats);
+    }
+    _destroy_data(data);
+    free(yindices);
     free(separator);
     free(print_separator);
+    destroy_filterplan(plan);
     destroy_filterlist(filterlist);
-    return 0;
+    return ok ? 0 : 1;
 }
-
+#endif // FD_LIBRARY
@@ -0,0 +1,80 @@
+#ifndef FILTERDATA_H
+#define FILTERDATA_H
+
+// libfilterdata: the filter and post-processing chain of filter_data for embedding
+//
+// Points are pushed in batches as they are produced and run through the same filters
+// (--xscale, --xmin, --every-nth, ...) and post-processing steps (--sample, -r, --tolerance,
+// --digital) as on the command line. The kept points are handed back through a callback,
+// so no intermediate file is needed.
+//
+//     struct fd_context* ctx = fd_create(2, on_points, userdata);
+//     fd_add_filter(ctx, FD_XMIN, 1e-9);
+//     fd_set_remove_redundant(ctx, 16, 16);
+//     while(simulating)
+//     {
+//         fd_push(ctx, x, y, n); // y holds 2 values per point
+//     }
+//     fd_finish(ctx);
+//     fd_destroy(ctx);
+//
+// Functions returning int return nonzero on success. Settings can only be changed before
+// the first fd_push. A context must not be used by several threads at once, independent
+// contexts can be used concurrently.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FD_API __attribute__((visibility("default")))
+
+struct fd_context;
+
+// kept points: n x values and n * numseries y values (all series of a point next to each other)
+// the arrays are only valid during the call
+typedef void (*fd_callback)(const double* x, const double* y, size_t n, void* userdata);
+
+enum fd_filter {
+    FD_XSCALE,
+    FD_YSCALE,
+    FD_XSHIFT,
+    FD_YSHIFT,
+    FD_XMIN,
+    FD_XMAX,
+    FD_EVERY_NTH
+};
+
+// like --sample-mode: the first point of every interval or one interpolated point per grid step
+enum fd_sample_mode {
+    FD_SAMPLE_FIRST,
+    FD_SAMPLE_LINEAR,
+    FD_SAMPLE_CUBIC
+};
+
+FD_API struct fd_context* fd_create(size_t numseries, fd_callback callback, void* userdata);
+FD_API void fd_destroy(struct fd_context* ctx);
+
+// filters run in the order they are added, like the command line options
+FD_API int fd_add_filter(struct fd_context* ctx, enum fd_filter filter, double arg);
+
+// post-processing steps, they always run in this order (like on the command line)
+FD_API int fd_set_sample(struct fd_context* ctx, double start, double interval);
+FD_API int fd_set_sample_mode(struct fd_context* ctx, enum fd_sample_mode mode);
+FD_API int fd_set_digital(struct fd_context* ctx, double threshold, double hysteresis);
+FD_API int fd_set_remove_redundant(struct fd_context* ctx, int xdecimals, int ydecimals);
+FD_API int fd_set_tolerance(struct fd_context* ctx, double tolerance);
+
+// x holds n values, y holds n * numseries values, x has to be increasing for sampling and
+// compression. The callback is called (at most once) before fd_push returns
+FD_API int fd_push(struct fd_context* ctx, const double* x, const double* y, size_t n);
+
+// end of the data: hands back the points that are still held back (compression)
+FD_API int fd_finish(struct fd_context* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILTERDATA_H
@@ -0,0 +1,14 @@
+#!/bin/sh
+# regression check: with --as-string every thread interns its own symbols, merging the chunks
+# (every chunk has strings of its own) has to map them to the strings a single thread prints
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+seq 0 1999999 | awk '{ print $1 ",s" int($1 / 100) }' > "$dir/strings.csv"
+./filter_data "$dir/strings.csv" 0 1 --as-string --xprecision 0 -j 1 > "$dir/serial.txt"
+./filter_data "$dir/strings.csv" 0 1 --as-string --xprecision 0 -j 4 > "$dir/parallel.txt"
+if ! cmp -s "$dir/serial.txt" "$dir/parallel.txt"; then
+    echo "as_string_threads: -j 4 output differs from -j 1 with --as-string" >&2
+    exit 1
+fi
+echo "as_string_threads: ok"
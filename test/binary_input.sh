@@ -0,0 +1,26 @@
+#!/bin/sh
+# binary output is read back from a file, streaming, standard input, compressed input and batch
+# mode parse text and have to reject it instead of printing zeros
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+seq 0 999 | awk '{ print $1 "," 2 * $1 }' > "$dir/rows.csv"
+./filter_data "$dir/rows.csv" 0 1 --output-format bin > "$dir/rows.bin"
+./filter_data "$dir/rows.csv" 0 1 > "$dir/text.txt"
+./filter_data "$dir/rows.bin" 0 1 > "$dir/binary.txt"
+if ! cmp -s "$dir/text.txt" "$dir/binary.txt"; then
+    echo "binary_input: binary input differs from the text it was written from" >&2
+    exit 1
+fi
+gzip -c "$dir/rows.bin" > "$dir/rows.bin.gz"
+echo "$dir/rows.bin $dir/batch.txt" > "$dir/manifest.txt"
+fail()
+{
+    echo "binary_input: $1 accepted binary input" >&2
+    exit 1
+}
+./filter_data "$dir/rows.bin" 0 1 --stream > /dev/null 2>&1 && fail "--stream"
+./filter_data - 0 1 < "$dir/rows.bin" > /dev/null 2>&1 && fail "standard input"
+./filter_data "$dir/rows.bin.gz" 0 1 > /dev/null 2>&1 && fail "compressed input"
+./filter_data --batch "$dir/manifest.txt" 0 1 > /dev/null 2>&1 && fail "--batch"
+echo "binary_input: ok"
@@ -0,0 +1,16 @@
+#!/bin/sh
+# --digital -r keeps only edges that survive the redundant point removal, reading all data first
+# has to print the same rows as streaming (single and several series, repeated x values)
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { srand(7); y = 0; for(i = 0; i < 100000; ++i) { y += rand() - 0.5; if(y > 1) y = 1; if(y < -1) y = -1; printf "%d,%.4f,%.4f\n", int(i / 3), y, -0.7 * y } }' > "$dir/noise.csv"
+for columns in 1 1,2; do
+    ./filter_data "$dir/noise.csv" 0 $columns --digital --hysteresis 0.2 -r --xprecision 0 > "$dir/batch.txt"
+    ./filter_data "$dir/noise.csv" 0 $columns --digital --hysteresis 0.2 -r --xprecision 0 --stream > "$dir/stream.txt"
+    if ! cmp -s "$dir/batch.txt" "$dir/stream.txt"; then
+        echo "digital_stream: --digital -r of columns $columns differs between batch and --stream" >&2
+        exit 1
+    fi
+done
+echo "digital_stream: ok"
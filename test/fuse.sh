@@ -0,0 +1,24 @@
+#!/bin/sh
+# fused filter stages only fold exact compositions, the output has to be byte-identical to
+# applying every filter on its own (--no-fuse)
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { srand(3); for(i = 0; i < 5000; ++i) printf "%.9g,%.9g\n", i * 0.001 + rand() * 1e-4, (rand() - 0.5) * 100 }' > "$dir/rows.csv"
+printf -- '-0,-0\n0,0\n-1e-300,1e-300\n' >> "$dir/rows.csv"
+while read -r filters; do
+    ./filter_data "$dir/rows.csv" 0 1 $filters > "$dir/fused.txt"
+    ./filter_data "$dir/rows.csv" 0 1 $filters --no-fuse > "$dir/single.txt"
+    if ! cmp -s "$dir/fused.txt" "$dir/single.txt"; then
+        echo "fuse: $filters differs from --no-fuse" >&2
+        exit 1
+    fi
+done << 'END'
+--xscale 1e9 --xscale 7 --yscale 3 --yshift 0.1 --xshift 2
+--xscale 0.1 --xshift 0.3 --xshift 0.7 --xmin 0.5 --xmax 4
+--xshift 0.1 --xscale 3 --yshift 0.1 --yscale 0.3
+--xscale -2 --xscale 0.1 --yscale 4 --yscale -0.7 --every-nth 3 --xmax 2.5
+--xmin -1 --xscale 1e3 --xmin 100 --xshift -7.25 --xmax 3000 --xscale 2
+--yscale -1 --yshift 0 --yscale 1e-3
+END
+echo "fuse: ok"
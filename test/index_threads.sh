@@ -0,0 +1,15 @@
+#!/bin/sh
+# regression check: with an index sidecar, parsing with several threads has to count rows
+# (--every-nth) from the start of the file like a single thread does
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+seq 0 2999999 | awk '{ print $1 "," $1 }' > "$dir/rows.csv"
+./filter_data "$dir/rows.csv" 0 1 --build-index > /dev/null
+./filter_data "$dir/rows.csv" 0 1 --xmin 1000000 --every-nth 10 --xprecision 0 --yprecision 0 -j 1 > "$dir/serial.txt"
+./filter_data "$dir/rows.csv" 0 1 --xmin 1000000 --every-nth 10 --xprecision 0 --yprecision 0 -j 4 > "$dir/parallel.txt"
+if ! cmp -s "$dir/serial.txt" "$dir/parallel.txt"; then
+    echo "index_threads: -j 4 output differs from -j 1 with an index" >&2
+    exit 1
+fi
+echo "index_threads: ok"
@@ -0,0 +1,37 @@
+#!/bin/sh
+# the in-place number parser and the fixed-point formatter have to give the same digits as
+# strtod and printf("%.*f") (awk uses both), for x and y, at several precisions
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { srand(11); for(i = 0; i < 20000; ++i) { e = int(rand() * 24) - 12; m = (rand() - 0.5) * 20; printf "%.*g,%.*g\n", 1 + int(rand() * 17), rand() * 10 ^ e, 1 + int(rand() * 17), m * 10 ^ e } }' > "$dir/numbers.csv"
+# rounding ties, signed zero, exponents, signs, leading zeros, missing digits, huge and denormal values
+cat >> "$dir/numbers.csv" << 'END'
+0.125,2.5
+-0,-0
+1E3,+5
+007.50,.5
+5.,-.25
+1e300,-1.7976931348623157e308
+4.9406564584124654e-324,2.2250738585072014e-308
+123456789012345678901234567890,9007199254740993
+0.1,0.30000000000000004
+1.0000000000000002,-0.000000000000000001
+END
+for precision in 0 1 2 3 6 9 12 16 19; do
+    ./filter_data "$dir/numbers.csv" 0 1 --xprecision $precision --yprecision $precision > "$dir/output.txt"
+    awk -F, -v p=$precision '{ printf "%.*f %.*f\n", p, $1, p, $2 }' "$dir/numbers.csv" > "$dir/expected.txt"
+    if ! cmp -s "$dir/output.txt" "$dir/expected.txt"; then
+        echo "numbers: output with $precision decimals differs from printf" >&2
+        diff "$dir/output.txt" "$dir/expected.txt" | head -n 6 >&2
+        exit 1
+    fi
+done
+# the default is 16 decimals
+./filter_data "$dir/numbers.csv" 0 1 > "$dir/output.txt"
+awk -F, '{ printf "%.16f %.16f\n", $1, $2 }' "$dir/numbers.csv" > "$dir/expected.txt"
+if ! cmp -s "$dir/output.txt" "$dir/expected.txt"; then
+    echo "numbers: default output differs from printf" >&2
+    exit 1
+fi
+echo "numbers: ok"
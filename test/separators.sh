@@ -0,0 +1,19 @@
+#!/bin/sh
+# field scanning (SSE2/AVX2 with a scalar tail) with single and multi-character separators:
+# columns in any order, the last needed column in the middle of a line, short lines with missing
+# fields (read as 0) and a multi-character print separator
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { srand(5); for(i = 0; i < 5000; ++i) { n = i % 97 == 0 ? 4 : 12; line = ""; for(c = 0; c < n; ++c) line = line (c > 0 ? "@" : "") sprintf("%.*g", 1 + int(rand() * 15), (rand() - 0.5) * 10 ^ (int(rand() * 8) - 2)); print line } }' > "$dir/fields.txt"
+for separator in ";" "::" ", " "<->"; do
+    sed "s/@/$separator/g" "$dir/fields.txt" > "$dir/input.txt"
+    ./filter_data "$dir/input.txt" 5 2,7,11,0 --separator "$separator" --print-separator " | " > "$dir/output.txt"
+    awk -F@ '{ printf "%.16f | %.16f | %.16f | %.16f | %.16f\n", $6, $3, $8, $12, $1 }' "$dir/fields.txt" > "$dir/expected.txt"
+    if ! cmp -s "$dir/output.txt" "$dir/expected.txt"; then
+        echo "separators: columns split at '$separator' differ from awk" >&2
+        diff "$dir/output.txt" "$dir/expected.txt" | head -n 6 >&2
+        exit 1
+    fi
+done
+echo "separators: ok"
@@ -0,0 +1,24 @@
+#!/bin/sh
+# parsing and formatting with several threads (chunks of the input, slices of the output) has to
+# print byte-identical output to a single thread
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { srand(13); y = 0; for(i = 0; i < 300000; ++i) { y += rand() - 0.5; printf "%.6f,%.5f,%.3f,%d\n", i * 1e-3, y, rand() * 1e4, int(rand() * 4) } }' > "$dir/rows.csv"
+while read -r options; do
+    ./filter_data "$dir/rows.csv" 0 1-3 $options -j 1 > "$dir/serial.txt"
+    for threads in 2 3 8; do
+        ./filter_data "$dir/rows.csv" 0 1-3 $options -j $threads > "$dir/parallel.txt"
+        if ! cmp -s "$dir/serial.txt" "$dir/parallel.txt"; then
+            echo "threads_output: -j $threads differs from -j 1 with '$options'" >&2
+            exit 1
+        fi
+    done
+done << 'END'
+--xprecision 3
+--yprecision 2 -r
+--xmin 12.5 --xmax 250 --every-nth 3 --yscale 2
+--digital --threshold 1.5 --hysteresis 0.5
+--y-float32 --yprecision 3
+END
+echo "threads_output: ok"
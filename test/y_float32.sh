@@ -0,0 +1,16 @@
+#!/bin/sh
+# --y-float32 must not change the output: y steps of one printed digit are compared by -r and
+# --tolerance, single precision rounding would merge some of them
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { for(i = 0; i < 20000; ++i) printf "%d,%.3f\n", i, 100 + int(i / 2) * 0.001 }' > "$dir/steps.csv"
+for options in "" "-r" "--tolerance 0.0005"; do
+    ./filter_data "$dir/steps.csv" 0 1 --yprecision 3 $options > "$dir/double.txt"
+    ./filter_data "$dir/steps.csv" 0 1 --yprecision 3 $options --y-float32 > "$dir/float.txt"
+    if ! cmp -s "$dir/double.txt" "$dir/float.txt"; then
+        echo "y_float32: --y-float32 changes the output of --yprecision 3 $options" >&2
+        exit 1
+    fi
+done
+echo "y_float32: ok"